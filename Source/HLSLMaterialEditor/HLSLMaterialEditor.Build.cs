@@ -36,6 +36,7 @@ public class HLSLMaterialEditor : ModuleRules
                 "DesktopPlatform",
                 "MaterialEditor",
                 "HLSLMaterialRuntime",
+                "HLSLParser",
                 "DeveloperSettings",
             });
 
@@ -5,6 +5,8 @@
 #include "HLSLMaterialUtilities.h"
 #include "HLSLMaterialFunctionLibrary.h"
 #include "MaterialEditorModule.h"
+#include "HLSLParser.h"
+#include "Misc/FileHelper.h"
 #include "Misc/MessageDialog.h"
 #include "Internationalization/Regex.h"
 
@@ -32,6 +34,22 @@ void FHLSLMaterialErrorHook::Register()
 }
 HLSL_STARTUP_FUNCTION(EDelayedRegisterRunPhase::EndOfEngineInit, FHLSLMaterialErrorHook::Register);
 
+namespace
+{
+	// File path -> function name -> line of its opening brace, 0-based
+	TMap<FString, TMap<FString, int32>> GFunctionLines;
+}
+
+FString FHLSLMaterialErrorHook::GetLineDirective(const FString& FilePath, const FString& FunctionName)
+{
+	return FString::Printf(TEXT("#line 1 \"%s%s%s%s%s\""), PathPrefix, *FilePath, FunctionSeparator, *FunctionName, PathSuffix);
+}
+
+void FHLSLMaterialErrorHook::SetFunctionLines(const FString& FilePath, TMap<FString, int32> FunctionLines)
+{
+	GFunctionLines.Add(FilePath, MoveTemp(FunctionLines));
+}
+
 void FHLSLMaterialErrorHook::HookMessageLogHack(IMaterialEditor& MaterialEditor)
 {
 	const TSharedPtr<FMaterialStats> StatsManager = static_cast<FMaterialEditor&>(MaterialEditor).MaterialStatsManager;
@@ -77,6 +95,7 @@ void FHLSLMaterialErrorHook::ReplaceMessages(FMessageLogListingViewModel& ViewMo
 
 			FString Path;
 			FString FullPath;
+			FString FunctionName;
 			FString ErrorPrefix;
 			FString ErrorSuffix;
 			{
@@ -92,6 +111,13 @@ void FHLSLMaterialErrorHook::ReplaceMessages(FMessageLogListingViewModel& ViewMo
 						continue;
 					}
 
+					// Path|Function: lines are relative to the function
+					FString FilePath;
+					if (Path.Split(FunctionSeparator, &FilePath, &FunctionName))
+					{
+						Path = FilePath;
+					}
+
 					FullPath = UHLSLMaterialFunctionLibrary::GetFilePath(Path);
 				}
 				else
@@ -160,7 +186,22 @@ void FHLSLMaterialErrorHook::ReplaceMessages(FMessageLogListingViewModel& ViewMo
 				continue;
 			}
 
-			FString DisplayText = FString::Printf(TEXT("%s:%s:%s"), *Path, *LineNumber, *CharStart);
+			FString DisplayPath = Path;
+			if (!FunctionName.IsEmpty())
+			{
+				int32 FunctionLine = 0;
+				if (FindFunctionLine(Path, FullPath, FunctionName, FunctionLine))
+				{
+					LineNumber = FString::FromInt(FunctionLine + FCString::Atoi(*LineNumber));
+				}
+				else
+				{
+					// Function was renamed or removed since: best we can do is the line in the function
+					DisplayPath += FunctionSeparator + FunctionName;
+				}
+			}
+
+			FString DisplayText = FString::Printf(TEXT("%s:%s:%s"), *DisplayPath, *LineNumber, *CharStart);
 			if (!CharEnd.IsEmpty())
 			{
 				DisplayText += "-" + CharEnd;
@@ -235,4 +276,36 @@ void FHLSLMaterialErrorHook::ReplaceMessages(FMessageLogListingViewModel& ViewMo
 		}
 		HLSL_CONST_CAST(Message->GetMessageTokens()) = NewTokens;
 	}
+}
+
+bool FHLSLMaterialErrorHook::FindFunctionLine(const FString& FilePath, const FString& FullPath, const FString& FunctionName, int32& OutLine)
+{
+	if (!GFunctionLines.Contains(FilePath))
+	{
+		// Material compiled before the library was generated in this session
+		TMap<FString, int32> FunctionLines;
+
+		FString Text;
+		TArray<FHLSLParsedFunction> Functions;
+		TArray<FHLSLParsedStruct> Structs;
+		if (FFileHelper::LoadFileToString(Text, *FullPath) &&
+			FHLSLParser::Parse({}, MoveTemp(Text), Functions, Structs).IsEmpty())
+		{
+			for (const FHLSLParsedFunction& Function : Functions)
+			{
+				FunctionLines.Add(Function.Name.ToString(), Function.StartLine);
+			}
+		}
+
+		SetFunctionLines(FilePath, MoveTemp(FunctionLines));
+	}
+
+	const int32* Line = GFunctionLines[FilePath].Find(FunctionName);
+	if (!Line)
+	{
+		return false;
+	}
+
+	OutLine = *Line;
+	return true;
 }
\ No newline at end of file
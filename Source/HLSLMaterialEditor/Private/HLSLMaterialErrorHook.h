@@ -12,10 +12,21 @@ class HLSLMATERIALEDITOR_API FHLSLMaterialErrorHook
 public:
 	static constexpr const TCHAR* PathPrefix = TEXT("[HLSLMaterial]");
 	static constexpr const TCHAR* PathSuffix = TEXT("[/HLSLMaterial]");
+	// Between the file path & the function name in the #line path
+	static constexpr const TCHAR* FunctionSeparator = TEXT("|");
 
 	static void Register();
 
+	// Makes the lines of the code below it relative to the opening brace of the function
+	// Doesn't depend on where the function is in the file, so adding a line above it doesn't change the generated code
+	static FString GetLineDirective(const FString& FilePath, const FString& FunctionName);
+	// Line of the opening brace of each function, to map the relative lines back to the file
+	// Must be called on every generation, as functions move whenever the file is edited
+	static void SetFunctionLines(const FString& FilePath, TMap<FString, int32> FunctionLines);
+
 private:
 	static void HookMessageLogHack(IMaterialEditor& MaterialEditor);
 	static void ReplaceMessages(FMessageLogListingViewModel& ViewModel);
+	// Parses the file if it wasn't generated since the editor started
+	static bool FindFunctionLine(const FString& FilePath, const FString& FullPath, const FString& FunctionName, int32& OutLine);
 };
\ No newline at end of file
@@ -2,9 +2,13 @@
 
 #include "HLSLMaterialFileWatcher.h"
 #include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialIncludeCache.h"
 #include "DirectoryWatcherModule.h"
 #include "Modules/ModuleManager.h"
 
+TMap<FString, TWeakPtr<FHLSLMaterialFileWatcher::FWatcher>> FHLSLMaterialFileWatcher::DirectoryToWatcher;
+TMap<FString, TArray<FHLSLMaterialFileWatcher*>> FHLSLMaterialFileWatcher::FileToWatchers;
+
 TSharedRef<FHLSLMaterialFileWatcher> FHLSLMaterialFileWatcher::Create(const TArray<FString>& InFilesToWatch)
 {
 	const TSharedRef<FHLSLMaterialFileWatcher> Watcher = MakeShareable(new FHLSLMaterialFileWatcher());
@@ -15,17 +19,44 @@ TSharedRef<FHLSLMaterialFileWatcher> FHLSLMaterialFileWatcher::Create(const TArr
 	{
 		ensure(File == FPaths::ConvertRelativePathToFull(File));
 		Directories.Add(FPaths::GetPath(File));
+		FileToWatchers.FindOrAdd(File).Add(&Watcher.Get());
 	}
 
-	const IDirectoryWatcher::FDirectoryChanged Callback = IDirectoryWatcher::FDirectoryChanged::CreateSP(&Watcher.Get(), &FHLSLMaterialFileWatcher::OnDirectoryChanged);
 	for (const FString& Directory : Directories)
 	{
-		Watcher->Watchers.Add(FWatcher::Create(Directory, Callback));
+		TSharedPtr<FWatcher> DirectoryWatcher = DirectoryToWatcher.FindRef(Directory).Pin();
+		if (!DirectoryWatcher)
+		{
+			DirectoryWatcher = FWatcher::Create(Directory, IDirectoryWatcher::FDirectoryChanged::CreateStatic(&FHLSLMaterialFileWatcher::OnDirectoryChanged));
+			if (DirectoryWatcher)
+			{
+				DirectoryToWatcher.Add(Directory, DirectoryWatcher);
+			}
+		}
+		Watcher->Watchers.Add(DirectoryWatcher);
 	}
 
 	return Watcher;
 }
 
+FHLSLMaterialFileWatcher::~FHLSLMaterialFileWatcher()
+{
+	for (const FString& File : FilesToWatch)
+	{
+		TArray<FHLSLMaterialFileWatcher*>* FileWatchers = FileToWatchers.Find(File);
+		if (!ensure(FileWatchers))
+		{
+			continue;
+		}
+
+		FileWatchers->RemoveSingleSwap(this);
+		if (FileWatchers->Num() == 0)
+		{
+			FileToWatchers.Remove(File);
+		}
+	}
+}
+
 bool FHLSLMaterialFileWatcher::Tick(float DeltaTime)
 {
 	if (bUpdateOnNextTick)
@@ -78,6 +109,11 @@ TSharedPtr<FHLSLMaterialFileWatcher::FWatcher> FHLSLMaterialFileWatcher::FWatche
 
 FHLSLMaterialFileWatcher::FWatcher::~FWatcher()
 {
+	if (!DirectoryToWatcher.FindRef(Directory).IsValid())
+	{
+		DirectoryToWatcher.Remove(Directory);
+	}
+
 	FDirectoryWatcherModule* Module = FModuleManager::GetModulePtr<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
 	if (!ensure(Module))
 	{
@@ -103,11 +139,21 @@ void FHLSLMaterialFileWatcher::OnDirectoryChanged(const TArray<FFileChangeData>&
 	for (const FFileChangeData& FileChange : FileChanges)
 	{
 		const FString AbsolutePath = FPaths::ConvertRelativePathToFull(FileChange.Filename);
-		if (FilesToWatch.Contains(AbsolutePath))
+
+		// Timestamps might not have changed yet, or be too coarse to notice a quick save
+		FHLSLMaterialIncludeCache::Invalidate(AbsolutePath);
+
+		const TArray<FHLSLMaterialFileWatcher*>* FileWatchers = FileToWatchers.Find(AbsolutePath);
+		if (!FileWatchers)
+		{
+			continue;
+		}
+
+		UE_LOG(LogHLSLMaterial, Log, TEXT("Update triggered from %s"), *AbsolutePath);
+
+		for (FHLSLMaterialFileWatcher* Watcher : *FileWatchers)
 		{
-			UE_LOG(LogHLSLMaterial, Log, TEXT("Update triggered from %s"), *AbsolutePath);
-			bUpdateOnNextTick = true;
-			break;
+			Watcher->bUpdateOnNextTick = true;
 		}
 	}
 }
\ No newline at end of file
@@ -16,6 +16,7 @@ public:
 	FSimpleMulticastDelegate OnFileChanged;
 
 	static TSharedRef<FHLSLMaterialFileWatcher> Create(const TArray<FString>& InFilesToWatch);
+	virtual ~FHLSLMaterialFileWatcher() override;
 
 protected:
 	//~ Begin FTickerObjectBase Interface
@@ -45,7 +46,12 @@ private:
 
 	bool bUpdateOnNextTick = false;
 
+	// Shared by all the libraries: each directory is only registered once,
+	// and each file maps to the watchers of the libraries including it
+	static TMap<FString, TWeakPtr<FWatcher>> DirectoryToWatcher;
+	static TMap<FString, TArray<FHLSLMaterialFileWatcher*>> FileToWatchers;
+
 	FHLSLMaterialFileWatcher() = default;
 
-	void OnDirectoryChanged(const TArray<FFileChangeData>& FileChanges);
+	static void OnDirectoryChanged(const TArray<FFileChangeData>& FileChanges);
 };
\ No newline at end of file
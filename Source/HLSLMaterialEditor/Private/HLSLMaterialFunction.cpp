@@ -2,24 +2,99 @@
 
 #include "HLSLMaterialFunction.h"
 #include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialSettings.h"
 
-FString FHLSLMaterialFunction::GenerateHashedString(const FString& BaseHash) const
+FString FHLSLMaterialFunction::GenerateHashedString(const FHLSLHash& BaseHash) const
 {
-	FString StringToHash =
-		BaseHash +
-		// Changes too often
-		//FString::FromInt(StartLine) + " " +
-		Comment + " " +
-		Metadata + " " +
-		ReturnType + " " +
-		Name + "(" +
-		FString::Join(Arguments, TEXT(",")) + ")" +
-		Body;
-
-	StringToHash.ReplaceInline(TEXT("\t"), TEXT(" "));
-	StringToHash.ReplaceInline(TEXT("\n"), TEXT(" "));
-
-	while (StringToHash.ReplaceInline(TEXT("  "), TEXT(" "))) {}
-
-	return "HLSL Hash: " + FHLSLMaterialUtilities::HashString(StringToHash);
+	FHLSLHashBuilder Builder;
+	Builder.Update(BaseHash);
+
+	// Whitespace changes don't matter
+	FHLSLWhitespaceCollapsingHasher Hasher(Builder);
+	// Changes too often
+	//Hasher.Update(FString::FromInt(StartLine) + " ");
+	Hasher.Update(Comment);
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(Metadata);
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(ReturnType.GetView());
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(Name.GetView());
+	Hasher.Update(TEXT("("));
+	for (int32 Index = 0; Index < Arguments.Num(); Index++)
+	{
+		if (Index > 0)
+		{
+			Hasher.Update(TEXT(","));
+		}
+		Hasher.Update(Arguments[Index].GetView());
+	}
+	Hasher.Update(TEXT(")"));
+	// Comments are only in the generated code if it's kept readable
+	if (GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode)
+	{
+		Hasher.Update(Body.GetView());
+	}
+	else
+	{
+		Hasher.Update(FHLSLParser::CanonicalizeCode(Body.GetView(), false));
+	}
+	Hasher.Finish();
+
+	return "HLSL Hash: " + Builder.Finalize().ToString();
+}
+
+bool FHLSLMaterialFunction::References(const FStringView Identifier) const
+{
+	if (FHLSLParser::ContainsIdentifier(ReturnType.GetView(), Identifier) ||
+		FHLSLParser::ContainsIdentifier(Body.GetView(), Identifier))
+	{
+		return true;
+	}
+	for (const FHLSLSpan& Argument : Arguments)
+	{
+		if (FHLSLParser::ContainsIdentifier(Argument.GetView(), Identifier))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FHLSLMaterialFunction::FindStructs(const TArray<FHLSLParsedStruct>& Structs, const TArray<TArray<int32>>& StructReferences)
+{
+	check(Structs.Num() == StructReferences.Num());
+
+	TArray<bool> IsUsed;
+	IsUsed.SetNumZeroed(Structs.Num());
+
+	TArray<int32> StructsToVisit;
+	for (int32 Index = 0; Index < Structs.Num(); Index++)
+	{
+		if (References(Structs[Index].Name.GetView()))
+		{
+			IsUsed[Index] = true;
+			StructsToVisit.Add(Index);
+		}
+	}
+	while (StructsToVisit.Num() > 0)
+	{
+		for (const int32 Reference : StructReferences[StructsToVisit.Pop(false)])
+		{
+			if (!IsUsed[Reference])
+			{
+				IsUsed[Reference] = true;
+				StructsToVisit.Add(Reference);
+			}
+		}
+	}
+
+	StructIndices.Reset();
+	for (int32 Index = 0; Index < Structs.Num(); Index++)
+	{
+		if (IsUsed[Index])
+		{
+			StructIndices.Add(Index);
+		}
+	}
 }
\ No newline at end of file
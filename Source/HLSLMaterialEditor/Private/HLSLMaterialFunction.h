@@ -3,18 +3,31 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HLSLParser.h"
 
-struct FHLSLMaterialFunction
-{
-	int32 StartLine = 0;
-	FString Comment;
-	FString Metadata;
-	FString ReturnType;
-	FString Name;
-	TArray<FString> Arguments;
-	FString Body;
+struct FHLSLHash;
 
+struct FHLSLMaterialFunction : FHLSLParsedFunction
+{
 	FString HashedString;
+	// Structs used by the signature or the body, directly or through another struct. Sorted indices in the library structs
+	TArray<int32> StructIndices;
+	// Defines given to the custom nodes, exactly the ones in the hash. Sorted indices in the library defines
+	TArray<int32> DefineIndices;
 	
-	FString GenerateHashedString(const FString& BaseHash) const;
+	FString GenerateHashedString(const FHLSLHash& BaseHash) const;
+
+	// True if the signature or the body uses Identifier
+	bool References(FStringView Identifier) const;
+	// StructReferences[Index] are the structs used by the body of Structs[Index]
+	void FindStructs(const TArray<FHLSLParsedStruct>& Structs, const TArray<TArray<int32>>& StructReferences);
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLMaterialFunction& Function)
+	{
+		Ar << static_cast<FHLSLParsedFunction&>(Function);
+		Ar << Function.HashedString;
+		Ar << Function.StructIndices;
+		Ar << Function.DefineIndices;
+		return Ar;
+	}
 };
\ No newline at end of file
@@ -5,13 +5,15 @@
 #include "HLSLMaterialMessages.h"
 #include "HLSLMaterialUtilities.h"
 #include "HLSLMaterialErrorHook.h"
+#include "HLSLMaterialSettings.h"
+#include "HLSLMaterialTempContainers.h"
 #include "HLSLMaterialFunctionLibrary.h"
+#include "HLSLParser.h"
 
 #include "Misc/ScopeExit.h"
 #include "IMaterialEditor.h"
 #include "MaterialEditorActions.h"
 #include "AssetToolsModule.h"
-#include "Internationalization/Regex.h"
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "Widgets/Notifications/SNotificationList.h"
 #include "Framework/Notifications/NotificationManager.h"
@@ -42,14 +44,20 @@
 FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 	UHLSLMaterialFunctionLibrary& Library,
 	const TArray<FString>& IncludeFilePaths,
+	const FString& IncludesDigest,
 	const TArray<FCustomDefine>& AdditionalDefines,
-	const TArray<FString>& Structs,
-	FHLSLMaterialFunction Function,
+	const TArray<FHLSLSpan>& Structs,
+	const FHLSLMaterialFunction& Function,
 	FMaterialUpdateContext& UpdateContext)
 {
+	// The temporaries of this generation are all freed at once when we return
+	FMemMark MemMark(FMemStack::Get());
+
+	const FString FunctionName = Function.Name.ToString();
+
 	TSoftObjectPtr<UMaterialFunction>* MaterialFunctionPtr = Library.MaterialFunctions.FindByPredicate([&](TSoftObjectPtr<UMaterialFunction> InFunction)
 	{
-		return InFunction && InFunction->GetFName() == *Function.Name;
+		return InFunction && InFunction->GetFName() == *FunctionName;
 	});
 	if (!MaterialFunctionPtr)
 	{
@@ -71,7 +79,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 	if (!MaterialFunction)
 	{
 		FString Error;
-		MaterialFunction = CreateAsset<UMaterialFunction>(Function.Name, BasePath, Error);
+		MaterialFunction = CreateAsset<UMaterialFunction>(FunctionName, BasePath, Error);
 
 		if (!Error.IsEmpty())
 		{
@@ -93,7 +101,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 	{
 		if (Comment && Comment->Text.Contains(Function.HashedString))
 		{
-			UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *Function.Name);
+			UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *FunctionName);
 			return {};
 		}
 	}
@@ -102,7 +110,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 	TArray<FPin> Outputs;
 	FString VariableDeclarations;
 
-	if (Function.ReturnType != "void")
+	if (Function.ReturnType != TEXT("void"))
 	{
 		return "Return type needs to be void";
 	}
@@ -125,32 +133,28 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		}
 	}
 
-	for (const FString& Argument : Function.Arguments)
+	for (const FHLSLSpan& ArgumentSpan : Function.Arguments)
 	{
-		FRegexPattern RegexPattern(""
-			R"_(^\s*)_"                      // Start
-			R"_((?:\[(.*)\])?)_"             // [Metadata]
-			R"_(\s*)_"                       // Spaces
-			R"_((?:(const\s+)?|(out\s+)?))_" // Either const or out
-			R"_((\w*))_"                     // Type
-			R"_(\s*)_"                       // Spaces
-			R"_((?:<\w+>)?)_"                // Potential (ignored) template, eg Texture2D<float>
-			R"_(\s+)_"                       // Spaces
-			R"_((\w*))_"                     // Name
-			R"_((?:\s*=\s*(.+))?)_"          // Optional default value
-			R"_(\s*$)_");                    // End
-		FRegexMatcher RegexMatcher(RegexPattern, Argument);
-		if (!RegexMatcher.FindNext())
+		FHLSLParsedDeclarator Argument;
+		{
+			const FString Error = FHLSLParser::ParseArgument(ArgumentSpan, Argument);
+			if (!Error.IsEmpty())
+			{
+				return "Invalid arguments syntax: " + Error;
+			}
+		}
+		if (!Argument.ArraySize.IsEmpty())
 		{
-			return "Invalid arguments syntax";
+			return "Array arguments are not supported: " + Argument.Name;
 		}
 
-		const FString Metadata = RegexMatcher.GetCaptureGroup(1);
-		const bool bIsConst = !RegexMatcher.GetCaptureGroup(2).IsEmpty();
-		const bool bIsOutput = !RegexMatcher.GetCaptureGroup(3).IsEmpty();
-		const FString Type = RegexMatcher.GetCaptureGroup(4);
-		const FString Name = RegexMatcher.GetCaptureGroup(5);
-		const FString DefaultValue = RegexMatcher.GetCaptureGroup(6);
+		// Template arguments are ignored, eg Texture2D<float>
+		const FString& Metadata = Argument.Metadata;
+		const bool bIsConst = Argument.bIsConst;
+		const bool bIsOutput = Argument.bIsOutput;
+		const FString& Type = Argument.Type;
+		const FString& Name = Argument.Name;
+		const FString& DefaultValue = Argument.DefaultValue;
 
 		if ((Type == "FMaterialPixelParameters" || Type == "FMaterialVertexParameters") &&
 			Name == "Parameters")
@@ -254,26 +258,37 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 	// Detect used texture coordinates
 	int32 MaxTexCoordinateUsed = -1;
 	{
-		FRegexPattern RegexPattern(R"_(Parameters.TexCoords\[([0-9]+)\])_");
-		FRegexMatcher RegexMatcher(RegexPattern, Function.Body);
-		while (RegexMatcher.FindNext())
+		// Parameters.TexCoords[N]
+		const FStringView Pattern = TEXT("Parameters.TexCoords[");
+		FStringView Body = Function.Body.GetView();
+		for (int32 Index = UE::String::FindFirst(Body, Pattern); Index != INDEX_NONE; Index = UE::String::FindFirst(Body, Pattern))
 		{
-			MaxTexCoordinateUsed = FMath::Max(MaxTexCoordinateUsed, FCString::Atoi(*RegexMatcher.GetCaptureGroup(1)));
+			Body.RightChopInline(Index + Pattern.Len());
+
+			int32 NumDigits = 0;
+			while (NumDigits < Body.Len() && FChar::IsDigit(Body[NumDigits]))
+			{
+				NumDigits++;
+			}
+			if (NumDigits > 0 && NumDigits < Body.Len() && Body[NumDigits] == TEXT(']'))
+			{
+				MaxTexCoordinateUsed = FMath::Max(MaxTexCoordinateUsed, FCString::Atoi(*FString(NumDigits, Body.GetData())));
+			}
 		}
 	}
 
 	// Detect used vertex colors
-	const bool bVertexColorUsed = Function.Body.Contains("Parameters.VertexColor", ESearchCase::CaseSensitive);
+	const bool bVertexColorUsed = Function.Body.Contains(TEXT("Parameters.VertexColor"));
 	// Detect whether NEEDS_WORLD_POSITION_EXCLUDING_SHADER_OFFSETS is required
-	const bool bNeedsWorldPositionExcludingShaderOffsets = Function.Body.Contains("GetWorldPosition_NoMaterialOffsets", ESearchCase::CaseSensitive);
+	const bool bNeedsWorldPositionExcludingShaderOffsets = Function.Body.Contains(TEXT("GetWorldPosition_NoMaterialOffsets"));
 
 	///////////////////////////////////////////////////////////////////////////////////
 	//// Past this point, try to never error out as it'll break existing functions ////
 	///////////////////////////////////////////////////////////////////////////////////
 
-	TMap<FName, FGuid> FunctionInputGuids;
-	TMap<FName, FGuid> FunctionOutputGuids;
-	TMap<FName, FGuid> ParameterGuids;
+	THLSLTempMap<FName, FGuid> FunctionInputGuids;
+	THLSLTempMap<FName, FGuid> FunctionOutputGuids;
+	THLSLTempMap<FName, FGuid> ParameterGuids;
 	for (UMaterialExpression* Expression : MaterialFunction->FunctionExpressions)
 	{
 		if (UMaterialExpressionFunctionInput* FunctionInput = Cast<UMaterialExpressionFunctionInput>(Expression))
@@ -336,7 +351,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		MaterialFunction->MarkPackageDirty();
 	};
 
-	TArray<int32> StaticBoolParameters;
+	THLSLTempArray<int32> StaticBoolParameters;
 	for (int32 Index = 0; Index < Inputs.Num(); Index++)
 	{
 		if (Inputs[Index].FunctionInputType == FunctionInput_StaticBool)
@@ -345,7 +360,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		}
 	}
 
-	TArray<UMaterialExpression*> FunctionInputs;
+	THLSLTempArray<UMaterialExpression*> FunctionInputs;
 	for (int32 Index = 0; Index < Inputs.Num(); Index++)
 	{
 		const FPin& Input = Inputs[Index];
@@ -529,7 +544,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		}
 	}
 
-	TArray<UMaterialExpressionFunctionOutput*> FunctionOutputs;
+	THLSLTempArray<UMaterialExpressionFunctionOutput*> FunctionOutputs;
 	for (int32 Index = 0; Index < Outputs.Num(); Index++)
 	{
 		const FPin& Output = Outputs[Index];
@@ -558,10 +573,14 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		int32 Index = 0;
 	};
 
-	TArray<TArray<FOutputPin>> AllOutputPins;
+	THLSLTempArray<THLSLTempArray<FOutputPin>> AllOutputPins;
+
+	// Reset for each permutation, keeping its allocation
+	FString LocalVariableDeclarations;
 	for (int32 Width = 0; Width < 1 << StaticBoolParameters.Num(); Width++)
 	{
-		FString LocalVariableDeclarations = VariableDeclarations;
+		LocalVariableDeclarations.Reset();
+		LocalVariableDeclarations += VariableDeclarations;
 		for (int32 Index = 0; Index < StaticBoolParameters.Num(); Index++)
 		{
 			bool bValue = Width & (1 << Index);
@@ -616,7 +635,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		MaterialExpressionCustom->MaterialExpressionGuid = FGuid::NewGuid();
 		MaterialExpressionCustom->bCollapsed = true;
 		MaterialExpressionCustom->OutputType = CMOT_Float1;
-		MaterialExpressionCustom->Code = GenerateFunctionCode(Library, Function, Structs, LocalVariableDeclarations);
+		MaterialExpressionCustom->Code = GenerateFunctionCode(Library, IncludesDigest, Function, Structs, LocalVariableDeclarations);
 		MaterialExpressionCustom->MaterialExpressionEditorX = 500;
 		MaterialExpressionCustom->MaterialExpressionEditorY = 200 * Width;
 		MaterialExpressionCustom->IncludeFilePaths = IncludeFilePaths;
@@ -694,7 +713,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 
 		MaterialExpressionCustom->PostEditChange();
 
-		TArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
+		THLSLTempArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
 		for (int32 Index = 0; Index < Outputs.Num(); Index++)
 		{
 			// + 1 as default output pin is result
@@ -707,11 +726,13 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		const int32 InputIndex = StaticBoolParameters[Layer];
 		const FPin& Input = Inputs[InputIndex];
 
-		const TArray<TArray<FOutputPin>> PreviousAllOutputPins = MoveTemp(AllOutputPins);
+		// Mem stack arrays can't be moved, MoveTemp would copy and leave AllOutputPins as is
+		const THLSLTempArray<THLSLTempArray<FOutputPin>> PreviousAllOutputPins = AllOutputPins;
+		AllOutputPins.Reset();
 
 		for (int32 Width = 0; Width < 1 << (StaticBoolParameters.Num() - Layer - 1); Width++)
 		{
-			TArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
+			THLSLTempArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
 			for (int32 Index = 0; Index < Outputs.Num(); Index++)
 			{
 				UClass* Class = UMaterialExpressionStaticSwitch::StaticClass();
@@ -813,7 +834,7 @@ FString FHLSLMaterialFunctionGenerator::GenerateFunction(
 		}
 	}
 
-	FNotificationInfo Info(FText::Format(INVTEXT("{0} updated"), FText::FromString(Function.Name)));
+	FNotificationInfo Info(FText::Format(INVTEXT("{0} updated"), FText::FromString(FunctionName)));
 	Info.ExpireDuration = 5.f;
 	Info.CheckBoxState = ECheckBoxState::Checked;
 	FSlateNotificationManager::Get().AddNotification(Info);
@@ -853,7 +874,7 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 	{
 		FunctionInputType = FunctionInput_Scalar;
 
-		if (!DefaultValue.IsEmpty() && !ParseDefaultValue(DefaultValue, 1, DefaultValueVector))
+		if (!DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(DefaultValue, 1, DefaultValueVector))
 		{
 			return DefaultValueError;
 		}
@@ -863,7 +884,7 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 		FunctionInputType = FunctionInput_Scalar;
 		CustomOutputType = CMOT_Float1;
 
-		if (!DefaultValue.IsEmpty() && !ParseDefaultValue(DefaultValue, 1, DefaultValueVector))
+		if (!DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(DefaultValue, 1, DefaultValueVector))
 		{
 			return DefaultValueError;
 		}
@@ -873,7 +894,7 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 		FunctionInputType = FunctionInput_Vector2;
 		CustomOutputType = CMOT_Float2;
 
-		if (!DefaultValue.IsEmpty() && !ParseDefaultValue(DefaultValue, 2, DefaultValueVector))
+		if (!DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(DefaultValue, 2, DefaultValueVector))
 		{
 			return DefaultValueError;
 		}
@@ -883,7 +904,7 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 		FunctionInputType = FunctionInput_Vector3;
 		CustomOutputType = CMOT_Float3;
 
-		if (!DefaultValue.IsEmpty() && !ParseDefaultValue(DefaultValue, 3, DefaultValueVector))
+		if (!DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(DefaultValue, 3, DefaultValueVector))
 		{
 			return DefaultValueError;
 		}
@@ -893,7 +914,7 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 		FunctionInputType = FunctionInput_Vector4;
 		CustomOutputType = CMOT_Float4;
 
-		if (!DefaultValue.IsEmpty() && !ParseDefaultValue(DefaultValue, 4, DefaultValueVector))
+		if (!DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(DefaultValue, 4, DefaultValueVector))
 		{
 			return DefaultValueError;
 		}
@@ -956,121 +977,53 @@ FString FHLSLMaterialFunctionGenerator::FPin::ParseTypeAndDefaultValue()
 	return {};
 }
 
-FString FHLSLMaterialFunctionGenerator::GenerateFunctionCode(const UHLSLMaterialFunctionLibrary& Library, const FHLSLMaterialFunction& Function, const TArray<FString>& Structs, const FString& Declarations)
+FString FHLSLMaterialFunctionGenerator::GenerateFunctionCode(
+	const UHLSLMaterialFunctionLibrary& Library,
+	const FString& IncludesDigest,
+	const FHLSLMaterialFunction& Function,
+	const TArray<FHLSLSpan>& Structs,
+	const FString& Declarations)
 {
 	FString Code;
-	for (const FString& Struct : Structs)
+	for (const FHLSLSpan& Struct : Structs)
 	{
 		Code += Struct;
 	}
 
-	Code += Function.Body.Replace(TEXT("return"), TEXT("return 0.f"));
+	FString Body = Function.Body.ToString();
+	Body.ReplaceInline(TEXT("return"), TEXT("return 0.f"));
 
 	if (Library.bAccurateErrors)
 	{
-		Code = FString::Printf(TEXT(
-			"#line %d \"%s%s%s\"\n%s\n#line 10000 \"Error occured outside of Custom HLSL node, line number will be inaccurate. "
+		// Lines relative to the function: the code doesn't change when lines are added above it
+		Code += FString::Printf(TEXT(
+			"%s\n%s\n#line 10000 \"Error occured outside of Custom HLSL node, line number will be inaccurate. "
 			"Untick bAccurateErrors on your HLSL library to fix this (%s)\""),
-			Function.StartLine + 1,
-			FHLSLMaterialErrorHook::PathPrefix,
-			*Library.File.FilePath,
-			FHLSLMaterialErrorHook::PathSuffix,
-			*Code,
+			*FHLSLMaterialErrorHook::GetLineDirective(Library.File.FilePath, Function.Name.ToString()),
+			*Body,
 			*Library.GetPathName());
 	}
-
-	return FString::Printf(TEXT("// START %s\n\n%s\n%s\n\n// END %s\n\nreturn 0.f;\n//%s\n"), *Function.Name, *Declarations, *Code, *Function.Name, *Function.HashedString);
-}
-
-bool FHLSLMaterialFunctionGenerator::ParseDefaultValue(const FString& DefaultValue, int32 Dimension, FVector4& OutValue)
-{
-	const FString FloatPattern = R"_(\s*(-?\s*\+?\s*(?:[0-9]*[.])?[0-9]*)f?\s*)_";
-
-	const auto TryParseFloat = [&](const FString& String, auto& OutFloatValue)
-	{
-		FRegexPattern RegexPattern("^" + FloatPattern + "$");
-		FRegexMatcher RegexMatcher(RegexPattern, String);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutFloatValue = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		return true;
-	};
-
-	if (Dimension == 1)
+	else
 	{
-		return TryParseFloat(DefaultValue, OutValue.X);
+		Code += Body;
 	}
-	else if (Dimension == 2)
-	{
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float2\\("+ FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
 
-		return true;
-	}
-	else if (Dimension == 3)
+	if (GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode)
 	{
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float3\\("+ FloatPattern + "," + FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
-		OutValue.Z = FCString::Atof(*RegexMatcher.GetCaptureGroup(3));
-
-		return true;
+		const FString FunctionName = Function.Name.ToString();
+		return FString::Printf(TEXT("// START %s\n\n%s\n%s\n\n// END %s\n\nreturn 0.f;\n//%s\n"), *FunctionName, *Declarations, *Code, *FunctionName, *Function.HashedString);
 	}
-	else
-	{
-		check(Dimension == 4);
-
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float4\\("+ FloatPattern + "," + FloatPattern + "," + FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
-		OutValue.Z = FCString::Atof(*RegexMatcher.GetCaptureGroup(3));
-		OutValue.W = FCString::Atof(*RegexMatcher.GetCaptureGroup(4));
 
-		return true;
+	// The code is part of the material shader map key: only keep what the compiler sees, so that comment & formatting edits reuse the compiled shaders
+	// The includes are the only input not in the code, their hash makes sure it still changes when they do
+	FString Result = FString::Printf(TEXT("%s\n%s\nreturn 0.f;\n"),
+		*FHLSLParser::CanonicalizeCode(Declarations, false),
+		*FHLSLParser::CanonicalizeCode(Code, Library.bAccurateErrors));
+	if (!IncludesDigest.IsEmpty())
+	{
+		Result += "//" + IncludesDigest + "\n";
 	}
+	return Result;
 }
 
 FString FHLSLMaterialFunctionGenerator::GenerateTooltip(const FString& ParamName, const FString& FunctionComment)
@@ -1125,15 +1078,91 @@ TMap<FString, FString> FHLSLMaterialFunctionGenerator::GenerateMetadata(const FS
 {
 	TMap<FString, FString> Result;
 
-	FRegexPattern RegexPattern(R"_((\w+)\s*(?:=\s*((?:"[^"]*")|\w+))?\s*(?:,|$))_");
-	FRegexMatcher RegexMatcher(RegexPattern, Metadata);
-	while (RegexMatcher.FindNext())
+	// Key [= Value | = "Value"], separated by commas
+	// Single pass: a regex would backtrack on long unquoted or unterminated values
+	const TCHAR* const Chars = *Metadata;
+	const int32 Num = Metadata.Len();
+
+	const auto IsWordChar = [](const TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_');
+	};
+	const auto SkipWhitespace = [&](int32& Index)
+	{
+		while (Index < Num && FChar::IsWhitespace(Chars[Index]))
+		{
+			Index++;
+		}
+	};
+	const auto ReadWord = [&](int32& Index)
 	{
-		const FString Key = RegexMatcher.GetCaptureGroup(1);
-		FString Value = RegexMatcher.GetCaptureGroup(2);
-		Value.RemoveFromStart(TEXT("\""));
-		Value.RemoveFromEnd(TEXT("\""));
+		const int32 Start = Index;
+		while (Index < Num && IsWordChar(Chars[Index]))
+		{
+			Index++;
+		}
+		return FString(Index - Start, Chars + Start);
+	};
+
+	int32 Index = 0;
+	while (Index < Num)
+	{
+		if (!IsWordChar(Chars[Index]))
+		{
+			Index++;
+			continue;
+		}
+
+		const FString Key = ReadWord(Index);
+		// If this isn't a valid entry, look for the next key right after this one
+		const int32 KeyEnd = Index;
+
+		int32 EntryIndex = Index;
+		SkipWhitespace(EntryIndex);
+
+		FString Value;
+		if (EntryIndex < Num && Chars[EntryIndex] == TEXT('='))
+		{
+			EntryIndex++;
+			SkipWhitespace(EntryIndex);
+
+			if (EntryIndex < Num && Chars[EntryIndex] == TEXT('"'))
+			{
+				// Each quote opens at most one value, so this stays linear
+				int32 ValueEnd = EntryIndex + 1;
+				while (ValueEnd < Num && Chars[ValueEnd] != TEXT('"'))
+				{
+					ValueEnd++;
+				}
+				if (ValueEnd == Num)
+				{
+					Index = KeyEnd;
+					continue;
+				}
+				Value = FString(ValueEnd - EntryIndex - 1, Chars + EntryIndex + 1);
+				EntryIndex = ValueEnd + 1;
+			}
+			else
+			{
+				Value = ReadWord(EntryIndex);
+				if (Value.IsEmpty())
+				{
+					Index = KeyEnd;
+					continue;
+				}
+			}
+
+			SkipWhitespace(EntryIndex);
+		}
+
+		if (EntryIndex < Num && Chars[EntryIndex] != TEXT(','))
+		{
+			Index = KeyEnd;
+			continue;
+		}
+
 		Result.Add(Key, Value);
+		Index = EntryIndex + 1;
 	}
 
 	return Result;
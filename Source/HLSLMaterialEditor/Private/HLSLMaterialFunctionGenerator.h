@@ -10,6 +10,7 @@
 class IMaterialEditor;
 class UHLSLMaterialFunctionLibrary;
 struct FHLSLMaterialFunction;
+struct FHLSLSpan;
 
 class FHLSLMaterialFunctionGenerator
 {
@@ -17,9 +18,11 @@ public:
 	static FString GenerateFunction(
 		UHLSLMaterialFunctionLibrary& Library,
 		const TArray<FString>& IncludeFilePaths,
+		// Digest of the included files, empty if there are none
+		const FString& IncludesDigest,
 		const TArray<FCustomDefine>& AdditionalDefines,
-		const TArray<FString>& Structs,
-		FHLSLMaterialFunction Function,
+		const TArray<FHLSLSpan>& Structs,
+		const FHLSLMaterialFunction& Function,
 		FMaterialUpdateContext& UpdateContext);
 
 private:
@@ -72,8 +75,12 @@ private:
 	static constexpr const TCHAR* META_Category = TEXT("Category");
 	static constexpr const TCHAR* FUNC_META_Prefix = TEXT("Prefix");
 
-	static FString GenerateFunctionCode(const UHLSLMaterialFunctionLibrary& Library, const FHLSLMaterialFunction& Function, const TArray<FString>& Structs, const FString& Declarations);
-	static bool ParseDefaultValue(const FString& DefaultValue, int32 Dimension, FVector4& OutValue);
+	static FString GenerateFunctionCode(
+		const UHLSLMaterialFunctionLibrary& Library,
+		const FString& IncludesDigest,
+		const FHLSLMaterialFunction& Function,
+		const TArray<FHLSLSpan>& Structs,
+		const FString& Declarations);
 	static FString GenerateTooltip(const FString& ParamName, const FString& FunctionComment);
 	static TMap<FString, FString> GenerateMetadata(const FString& Metadata);
 		
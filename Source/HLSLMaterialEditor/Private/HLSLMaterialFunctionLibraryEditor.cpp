@@ -6,10 +6,16 @@
 #include "HLSLMaterialFunctionGenerator.h"
 #include "HLSLMaterialParser.h"
 #include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialErrorHook.h"
 #include "HLSLMaterialFileWatcher.h"
+#include "HLSLMaterialIncludeCache.h"
+#include "HLSLMaterialIRCache.h"
 #include "HLSLMaterialMessages.h"
+#include "HLSLMaterialPackageStamp.h"
+#include "HLSLMaterialSettings.h"
 
 #include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
 #include "AssetRegistry/AssetData.h"
 #include "Materials/MaterialFunction.h"
 #include "AssetRegistry/AssetRegistryModule.h"
@@ -71,13 +77,17 @@ TSharedRef<FVirtualDestructor> FHLSLMaterialFunctionLibraryEditor::CreateWatcher
 		FString Text;
 		if (TryLoadFileToString(Text, Library.GetFilePath()))
 		{
+			TArray<FString> VirtualPaths;
 			for (const FHLSLMaterialParser::FInclude& Include : FHLSLMaterialParser::GetIncludes(FullPath, Text))
 			{
+				VirtualPaths.Add(Include.VirtualPath);
+
 				if (!Include.DiskPath.IsEmpty())
 				{
 					Files.Add(Include.DiskPath);
 				}
 			}
+			Files.Append(FHLSLMaterialIncludeCache::GetNestedIncludes(VirtualPaths));
 		}
 	}
 
@@ -106,71 +116,343 @@ void FHLSLMaterialFunctionLibraryEditor::Generate(UHLSLMaterialFunctionLibrary&
 		return;
 	}
 	
-	FString BaseHash;
+	TArray<FHLSLMaterialParser::FInclude> Includes;
+	TArray<FCustomDefine> AdditionalDefines;
+	FHLSLMaterialParser::GetDirectives(FullPath, Text, Includes, AdditionalDefines);
+
+	FHLSLHashBuilder SourceHashBuilder;
+	SourceHashBuilder.Update(Text);
+	SourceHashBuilder.Update(&Library.bAccurateErrors, sizeof(bool));
+
+	// Includes can't be tracked without parsing them: every function depends on all of them
+	FHLSLHashBuilder IncludesHashBuilder;
+	{
+		// Changes the code of every function
+		const bool bReadableGeneratedCode = GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode;
+		IncludesHashBuilder.Update(&bReadableGeneratedCode, sizeof(bool));
+		SourceHashBuilder.Update(&bReadableGeneratedCode, sizeof(bool));
+	}
 	TArray<FString> IncludeFilePaths;
-	for (const FHLSLMaterialParser::FInclude& Include : FHLSLMaterialParser::GetIncludes(FullPath, Text))
+	// Of all the included files, computed once for all the custom nodes
+	FHLSLHashBuilder IncludesDigestBuilder;
+	for (const FHLSLMaterialParser::FInclude& Include : Includes)
 	{
 		IncludeFilePaths.Add(Include.VirtualPath);
 
-		FString IncludeText;
-		if (TryLoadFileToString(IncludeText, Include.DiskPath))
+		FHLSLHash IncludeHash;
+		if (FHLSLMaterialIncludeCache::GetHash(Include.DiskPath, IncludeHash))
 		{
-			BaseHash += FHLSLMaterialUtilities::HashString(IncludeText);
+			IncludesHashBuilder.Update(IncludeHash);
+			SourceHashBuilder.Update(IncludeHash);
+			IncludesDigestBuilder.Update(IncludeHash);
 		}
 		else
 		{
-			FHLSLMaterialMessages::ShowError(TEXT("Invalid include: %s"), *Include.VirtualPath);
+			FHLSLMaterialMessages::ShowError(TEXT("Invalid include: %s (line %d)"), *Include.VirtualPath, Include.Line);
 		}
 	}
+	for (const FString& DiskPath : FHLSLMaterialIncludeCache::GetNestedIncludes(IncludeFilePaths))
+	{
+		FHLSLHash IncludeHash;
+		if (FHLSLMaterialIncludeCache::GetHash(DiskPath, IncludeHash))
+		{
+			IncludesHashBuilder.Update(IncludeHash);
+			SourceHashBuilder.Update(IncludeHash);
+			IncludesDigestBuilder.Update(IncludeHash);
+		}
+	}
+
+	const FString IncludesDigest = IncludeFilePaths.Num() > 0 ? IncludesDigestBuilder.Finalize().ToString() : FString();
 
-	TArray<FCustomDefine> AdditionalDefines = FHLSLMaterialParser::GetDefines(Text);
 	AdditionalDefines.Add({ "ENGINE_VERSION", FString::FromInt(ENGINE_VERSION) });
+	// The only define not coming from the text
+	SourceHashBuilder.Update(AdditionalDefines.Last().DefineValue);
 
-	for (const FCustomDefine& Define : AdditionalDefines)
+	// Bump when the functions or their serialization change
+	constexpr int32 IRCacheVersion = 5;
+
+	TArray<FHLSLMaterialFunction> Functions;
+	TArray<FHLSLParsedStruct> Structs;
+	const auto SerializeIR = [&](FArchive& Ar)
 	{
-		BaseHash += FHLSLMaterialUtilities::HashString(Define.DefineName);
-		BaseHash += FHLSLMaterialUtilities::HashString(Define.DefineValue);
+		Ar << Functions;
+		Ar << Structs;
+	};
+
+	// Source unchanged since a previous session: functions are loaded with their hash
+	// Only saved once every function generated: loaded spans lose their file location, errors would be reported at 1:1
+	const FHLSLHash SourceHash = SourceHashBuilder.Finalize();
+	const bool bSaveIRCache = !FHLSLMaterialIRCache::Load(Library, IRCacheVersion, SourceHash, SerializeIR);
+	if (bSaveIRCache)
+	{
+		Functions.Reset();
+		Structs.Reset();
+
+		{
+			const FString Error = FHLSLMaterialParser::Parse(Library, MoveTemp(Text), Functions, Structs);
+			if (!Error.IsEmpty())
+			{
+				FHLSLMaterialMessages::ShowError(TEXT("Parsing failed: %s"), *Error);
+				return;
+			}
+		}
+
+		TArray<TArray<int32>> StructReferences;
+		for (const FHLSLParsedStruct& Struct : Structs)
+		{
+			TArray<int32>& References = StructReferences.Emplace_GetRef();
+			for (int32 Index = 0; Index < Structs.Num(); Index++)
+			{
+				if (&Structs[Index] != &Struct &&
+					FHLSLParser::ContainsIdentifier(Struct.Body.GetView(), Structs[Index].Name.GetView()))
+				{
+					References.Add(Index);
+				}
+			}
+		}
+
+		for (FHLSLMaterialFunction& Function : Functions)
+		{
+			Function.FindStructs(Structs, StructReferences);
+		}
+
+		// Defines used by a function or one of its structs
+		const auto UsesDefine = [&](const FHLSLMaterialFunction& Function, const FCustomDefine& Define)
+		{
+			if (Function.References(Define.DefineName))
+			{
+				return true;
+			}
+			for (const int32 StructIndex : Function.StructIndices)
+			{
+				if (FHLSLParser::ContainsIdentifier(Structs[StructIndex].Body.GetView(), Define.DefineName))
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		// DefineReferences[Index] are the defines used by the value of AdditionalDefines[Index]
+		TArray<TArray<int32>> DefineReferences;
+		for (const FCustomDefine& Define : AdditionalDefines)
+		{
+			TArray<int32>& References = DefineReferences.Emplace_GetRef();
+			for (int32 Index = 0; Index < AdditionalDefines.Num(); Index++)
+			{
+				if (&AdditionalDefines[Index] != &Define &&
+					FHLSLParser::ContainsIdentifier(Define.DefineValue, AdditionalDefines[Index].DefineName))
+				{
+					References.Add(Index);
+				}
+			}
+		}
+		// Adds the defines used by the values of the ones already in IsUsed
+		const auto AddReferencedDefines = [&](TArray<bool>& IsUsed)
+		{
+			TArray<int32> DefinesToVisit;
+			for (int32 Index = 0; Index < IsUsed.Num(); Index++)
+			{
+				if (IsUsed[Index])
+				{
+					DefinesToVisit.Add(Index);
+				}
+			}
+			while (DefinesToVisit.Num() > 0)
+			{
+				for (const int32 Reference : DefineReferences[DefinesToVisit.Pop(false)])
+				{
+					if (!IsUsed[Reference])
+					{
+						IsUsed[Reference] = true;
+						DefinesToVisit.Add(Reference);
+					}
+				}
+			}
+		};
+
+		// Defines each function uses, directly or through another define
+		TArray<TArray<bool>> UsedDefines;
+		for (const FHLSLMaterialFunction& Function : Functions)
+		{
+			TArray<bool>& IsUsed = UsedDefines.Emplace_GetRef();
+			for (const FCustomDefine& Define : AdditionalDefines)
+			{
+				IsUsed.Add(UsesDefine(Function, Define));
+			}
+			AddReferencedDefines(IsUsed);
+		}
+
+		// Defines the includes might read, and the ones no function uses: most likely there for the includes
+		// Given to every function, as we can't tell which ones use the includes' macros
+		TArray<bool> IncludeDefines;
+		{
+			const TSet<FString> IncludeIdentifiers = FHLSLMaterialIncludeCache::GetIdentifiers(IncludeFilePaths);
+			for (int32 Index = 0; Index < AdditionalDefines.Num(); Index++)
+			{
+				bool bIsUsed = false;
+				for (const TArray<bool>& IsUsed : UsedDefines)
+				{
+					bIsUsed |= IsUsed[Index];
+				}
+				IncludeDefines.Add(!bIsUsed || IncludeIdentifiers.Contains(AdditionalDefines[Index].DefineName));
+			}
+			AddReferencedDefines(IncludeDefines);
+		}
+
+		for (int32 Index = 0; Index < AdditionalDefines.Num(); Index++)
+		{
+			if (IncludeDefines[Index])
+			{
+				IncludesHashBuilder.Update(AdditionalDefines[Index].DefineName);
+				IncludesHashBuilder.Update(AdditionalDefines[Index].DefineValue);
+			}
+		}
+		const FHLSLHash IncludesHash = IncludesHashBuilder.Finalize();
+
+		// Only the structs & defines a function uses are part of its hash: editing one only regenerates the functions using it
+		// Functions that weren't edited and whose dependencies didn't change keep their hash
+		FHLSLIncrementalParser& IncrementalParser = FHLSLMaterialParser::GetIncrementalParser(Library);
+		for (int32 FunctionIndex = 0; FunctionIndex < Functions.Num(); FunctionIndex++)
+		{
+			FHLSLMaterialFunction& Function = Functions[FunctionIndex];
+
+			FHLSLHashBuilder DependenciesHashBuilder;
+			DependenciesHashBuilder.Update(IncludesHash);
+			for (const int32 StructIndex : Function.StructIndices)
+			{
+				DependenciesHashBuilder.Update(Structs[StructIndex].Text.GetView());
+			}
+
+			// The nodes only get the defines in the hash: editing another one can't change them
+			Function.DefineIndices.Reset();
+			for (int32 Index = 0; Index < AdditionalDefines.Num(); Index++)
+			{
+				if (UsedDefines[FunctionIndex][Index] || IncludeDefines[Index])
+				{
+					Function.DefineIndices.Add(Index);
+					DependenciesHashBuilder.Update(AdditionalDefines[Index].DefineName);
+					DependenciesHashBuilder.Update(AdditionalDefines[Index].DefineValue);
+				}
+			}
+			const FHLSLHash DependenciesHash = DependenciesHashBuilder.Finalize();
+
+			Function.HashedString = IncrementalParser.GetFunctionHash(FunctionIndex, DependenciesHash.ToString(), [&]
+			{
+				return Function.GenerateHashedString(DependenciesHash);
+			});
+		}
 	}
 
-	TArray<FHLSLMaterialFunction> Functions;
-	TArray<FString> Structs;
 	{
-		const FString Error = FHLSLMaterialParser::Parse(Library, Text, Functions, Structs);
-		if (!Error.IsEmpty())
+		// Even if the functions are up to date: they might have moved in the file
+		TMap<FString, int32> FunctionLines;
+		for (const FHLSLMaterialFunction& Function : Functions)
 		{
-			FHLSLMaterialMessages::ShowError(TEXT("Parsing failed: %s"), *Error);
-			return;
+			FunctionLines.Add(Function.Name.ToString(), Function.StartLine);
 		}
+		FHLSLMaterialErrorHook::SetFunctionLines(Library.File.FilePath, MoveTemp(FunctionLines));
 	}
 
-	for (const FString& Struct : Structs)
+	FHLSLHashBuilder FingerprintBuilder;
+	FingerprintBuilder.Update(&Library.bAccurateErrors, sizeof(bool));
+	for (const FHLSLMaterialFunction& Function : Functions)
 	{
-		BaseHash += Struct;
+		FingerprintBuilder.Update(Function.HashedString);
+	}
+	const FString Fingerprint = FingerprintBuilder.Finalize().ToString();
+
+	// Packages of the functions, empty if one of them was never generated
+	const auto GetPackageStamp = [&]
+	{
+		TArray<FString> PackageNames;
+		for (const FHLSLMaterialFunction& Function : Functions)
+		{
+			const FString FunctionName = Function.Name.ToString();
+			const TSoftObjectPtr<UMaterialFunction>* MaterialFunction = Library.MaterialFunctions.FindByPredicate([&](const TSoftObjectPtr<UMaterialFunction>& InFunction)
+			{
+				return InFunction.GetAssetName() == FunctionName;
+			});
+			if (!MaterialFunction)
+			{
+				return FString();
+			}
+			PackageNames.Add(MaterialFunction->GetLongPackageName());
+		}
+		return FHLSLMaterialPackageStamp::Get(PackageNames);
+	};
+
+	// Same source as last time and no function was touched since they were found up to date: no need to load them
+	{
+		const FString PackageStamp = GetPackageStamp();
+		if (Library.GeneratedFingerprint == Fingerprint &&
+			!PackageStamp.IsEmpty() &&
+			Library.GeneratedPackageStamp == PackageStamp)
+		{
+			// The fingerprint is only set once every function generated without errors
+			if (bSaveIRCache)
+			{
+				FHLSLMaterialIRCache::Save(Library, IRCacheVersion, SourceHash, SerializeIR);
+			}
+
+			UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *Library.GetName());
+			return;
+		}
 	}
 
 	Library.MaterialFunctions.RemoveAll([&](TSoftObjectPtr<UMaterialFunction> InFunction)
 	{
 		return !InFunction.LoadSynchronous();
 	});
-	
+
+	bool bHasErrors = false;
 	FMaterialUpdateContext UpdateContext;
-	for (FHLSLMaterialFunction Function : Functions)
+	for (FHLSLMaterialFunction& Function : Functions)
 	{
-		Function.HashedString = Function.GenerateHashedString(BaseHash);
-		
+		// Only the structs & defines it uses: the others are not part of its hash
+		TArray<FHLSLSpan> FunctionStructs;
+		for (const int32 StructIndex : Function.StructIndices)
+		{
+			FunctionStructs.Add(Structs[StructIndex].Text);
+		}
+		TArray<FCustomDefine> FunctionDefines;
+		for (const int32 DefineIndex : Function.DefineIndices)
+		{
+			FunctionDefines.Add(AdditionalDefines[DefineIndex]);
+		}
+
 		const FString Error = FHLSLMaterialFunctionGenerator::GenerateFunction(
 			Library, 
 			IncludeFilePaths, 
-			AdditionalDefines,
-			Structs,
+			IncludesDigest,
+			FunctionDefines,
+			FunctionStructs,
 			Function,
 			UpdateContext);
 
 		if (!Error.IsEmpty())
 		{
-			FHLSLMaterialMessages::ShowError(TEXT("Function %s: %s"), *Function.Name, *Error);
+			FHLSLMaterialMessages::ShowError(TEXT("Function %s: %s"), *Function.Name.ToString(), *Error);
+			bHasErrors = true;
 		}
 	}
+
+	if (bSaveIRCache && !bHasErrors)
+	{
+		FHLSLMaterialIRCache::Save(Library, IRCacheVersion, SourceHash, SerializeIR);
+	}
+
+	// Failed functions must be generated again next time, even if the source didn't change
+	const FString NewFingerprint = bHasErrors ? FString() : Fingerprint;
+	// Each function checked its hash comment: empty if one of them was regenerated and isn't saved yet
+	const FString NewPackageStamp = bHasErrors ? FString() : GetPackageStamp();
+	if (Library.GeneratedFingerprint != NewFingerprint ||
+		Library.GeneratedPackageStamp != NewPackageStamp)
+	{
+		Library.GeneratedFingerprint = NewFingerprint;
+		Library.GeneratedPackageStamp = NewPackageStamp;
+		Library.MarkPackageDirty();
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -14,6 +14,6 @@ public:
 	static TSharedRef<FVirtualDestructor> CreateWatcher(UHLSLMaterialFunctionLibrary& Library);
 	static void Generate(UHLSLMaterialFunctionLibrary& Library);
 
-private:
+	// Retries once if the file is locked by the text editor
 	static bool TryLoadFileToString(FString& Text, const FString& FullPath);
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+// Copyright Phyronnaz
+
+#include "HLSLMaterialIRCache.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformFileManager.h"
+#include "UObject/Object.h"
+#include "Async/MappedFileHandle.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	// "HLIR"
+	constexpr uint32 HLSLIRCacheMagic = 0x52494C48;
+	// Bump when the header changes
+	constexpr int32 HLSLIRCacheFormatVersion = 1;
+
+	bool SerializeHeader(FArchive& Ar, int32& Version, const FHLSLHash& Fingerprint)
+	{
+		uint32 Magic = HLSLIRCacheMagic;
+		int32 FormatVersion = HLSLIRCacheFormatVersion;
+		FHLSLHash Hash = Fingerprint;
+
+		Ar << Magic;
+		Ar << FormatVersion;
+		Ar << Version;
+		Ar << Hash.A;
+		Ar << Hash.B;
+
+		return
+			!Ar.IsError() &&
+			Magic == HLSLIRCacheMagic &&
+			FormatVersion == HLSLIRCacheFormatVersion &&
+			Hash == Fingerprint;
+	}
+}
+
+bool FHLSLMaterialIRCache::Load(const UObject& Library, const int32 Version, const FHLSLHash& Fingerprint, const TFunctionRef<void(FArchive&)> Serialize)
+{
+	const FString Path = GetPath(Library);
+
+	const auto LoadFromView = [&](const TArrayView<const uint8> Bytes)
+	{
+		FMemoryReaderView Reader(Bytes, true);
+
+		int32 FileVersion = Version;
+		if (!SerializeHeader(Reader, FileVersion, Fingerprint) ||
+			FileVersion != Version)
+		{
+			return false;
+		}
+
+		Serialize(Reader);
+
+		if (Reader.IsError())
+		{
+			UE_LOG(LogHLSLMaterial, Warning, TEXT("Corrupted cache %s"), *Path);
+			return false;
+		}
+		return true;
+	};
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	const TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+	if (MappedFile && MappedFile->GetFileSize() > 0)
+	{
+		const TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+		if (MappedRegion)
+		{
+			return LoadFromView(MakeArrayView(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize()));
+		}
+	}
+
+	// Mapping is not supported on all platforms
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path))
+	{
+		return false;
+	}
+	return LoadFromView(Bytes);
+}
+
+void FHLSLMaterialIRCache::Save(const UObject& Library, const int32 Version, const FHLSLHash& Fingerprint, const TFunctionRef<void(FArchive&)> Serialize)
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes, true);
+
+	int32 FileVersion = Version;
+	SerializeHeader(Writer, FileVersion, Fingerprint);
+	Serialize(Writer);
+
+	const FString Path = GetPath(Library);
+	if (!FFileHelper::SaveArrayToFile(Bytes, *Path))
+	{
+		UE_LOG(LogHLSLMaterial, Warning, TEXT("Failed to write %s"), *Path);
+	}
+}
+
+FString FHLSLMaterialIRCache::GetPath(const UObject& Library)
+{
+	// Libraries with the same name in different folders
+	const uint32 PathHash = FCrc::StrCrc32(*Library.GetPathName());
+	return FPaths::ProjectIntermediateDir() / TEXT("HLSLMaterial") / FString::Printf(TEXT("%s_%08x.bin"), *Library.GetName(), PathHash);
+}
@@ -0,0 +1,22 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HLSLMaterialUtilities.h"
+
+class UObject;
+
+// What a library parsed from its file, saved in Intermediate/ so that the next editor session doesn't have to parse it again
+// One file per library, only valid for the fingerprint of the source it was parsed from
+class HLSLMATERIALEDITOR_API FHLSLMaterialIRCache
+{
+public:
+	// Version must be bumped whenever what Serialize writes changes
+	// Returns false if there is no file, or if it's for another fingerprint or version. Serialize is then not called
+	static bool Load(const UObject& Library, int32 Version, const FHLSLHash& Fingerprint, TFunctionRef<void(FArchive&)> Serialize);
+	static void Save(const UObject& Library, int32 Version, const FHLSLHash& Fingerprint, TFunctionRef<void(FArchive&)> Serialize);
+
+private:
+	static FString GetPath(const UObject& Library);
+};
@@ -0,0 +1,225 @@
+// Copyright Phyronnaz
+
+#include "HLSLMaterialIncludeCache.h"
+#include "HLSLMaterialFunctionLibraryEditor.h"
+#include "HLSLParser.h"
+#include "ShaderCore.h"
+#include "HAL/FileManager.h"
+
+namespace
+{
+	struct FHLSLIncludeCacheEntry
+	{
+		FDateTime ModificationTime;
+		int64 FileSize = 0;
+		// Set by the directory watchers: timestamps might not have changed yet, or be too coarse to notice a quick save
+		bool bStale = false;
+		FHLSLHash Hash;
+		// As written in the file, relative or not
+		TArray<FString> Includes;
+		// Every word of the file, comments included
+		TSet<FString> Identifiers;
+	};
+
+	TMap<FString, FHLSLIncludeCacheEntry> GHLSLIncludeCache;
+	bool GHLSLIncludesChanged = false;
+
+	const FHLSLIncludeCacheEntry* FindOrUpdateEntry(const FString& DiskPath)
+	{
+		check(IsInGameThread());
+
+		const FString AbsolutePath = FPaths::ConvertRelativePathToFull(DiskPath);
+
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*AbsolutePath);
+		if (!StatData.bIsValid || StatData.bIsDirectory)
+		{
+			GHLSLIncludeCache.Remove(AbsolutePath);
+			return nullptr;
+		}
+
+		FHLSLIncludeCacheEntry* Entry = GHLSLIncludeCache.Find(AbsolutePath);
+		if (Entry &&
+			!Entry->bStale &&
+			Entry->ModificationTime == StatData.ModificationTime &&
+			Entry->FileSize == StatData.FileSize)
+		{
+			return Entry;
+		}
+
+		FString Text;
+		if (!FHLSLMaterialFunctionLibraryEditor::TryLoadFileToString(Text, AbsolutePath))
+		{
+			GHLSLIncludeCache.Remove(AbsolutePath);
+			return nullptr;
+		}
+
+		const FHLSLHash Hash = FHLSLMaterialUtilities::HashString(Text);
+		if (!Entry || Entry->Hash != Hash)
+		{
+			GHLSLIncludesChanged = true;
+		}
+
+		if (!Entry)
+		{
+			Entry = &GHLSLIncludeCache.Add(AbsolutePath);
+		}
+		Entry->ModificationTime = StatData.ModificationTime;
+		Entry->FileSize = StatData.FileSize;
+		Entry->bStale = false;
+		Entry->Hash = Hash;
+
+		Entry->Includes.Reset();
+		for (const FHLSLParsedInclude& Include : FHLSLParser::GetDirectives(Text).Includes)
+		{
+			Entry->Includes.Add(Include.Path);
+		}
+
+		Entry->Identifiers.Reset();
+		for (int32 Index = 0; Index < Text.Len();)
+		{
+			if (!FChar::IsAlnum(Text[Index]) && Text[Index] != TEXT('_'))
+			{
+				Index++;
+				continue;
+			}
+
+			const int32 Start = Index;
+			while (Index < Text.Len() && (FChar::IsAlnum(Text[Index]) || Text[Index] == TEXT('_')))
+			{
+				Index++;
+			}
+			// Skip numbers
+			if (!FChar::IsDigit(Text[Start]))
+			{
+				Entry->Identifiers.Add(Text.Mid(Start, Index - Start));
+			}
+		}
+
+		return Entry;
+	}
+
+	struct FHLSLIncludeVisitor
+	{
+		TSet<FString> Visited;
+		// Files being visited, to report cycles
+		TArray<FString> Stack;
+		TArray<FString> NestedDiskPaths;
+
+		void Visit(const FString& VirtualPath, const bool bIsNested)
+		{
+			const int32 StackIndex = Stack.Find(VirtualPath);
+			if (StackIndex != INDEX_NONE)
+			{
+				FString Cycle;
+				for (int32 Index = StackIndex; Index < Stack.Num(); Index++)
+				{
+					Cycle += Stack[Index] + TEXT(" -> ");
+				}
+				Cycle += VirtualPath;
+
+				UE_LOG(LogHLSLMaterial, Warning, TEXT("Include cycle: %s"), *Cycle);
+				return;
+			}
+
+			if (Visited.Contains(VirtualPath))
+			{
+				return;
+			}
+			Visited.Add(VirtualPath);
+
+			const FString DiskPath = GetShaderSourceFilePath(VirtualPath);
+			if (DiskPath.IsEmpty())
+			{
+				return;
+			}
+
+			if (bIsNested)
+			{
+				NestedDiskPaths.Add(FPaths::ConvertRelativePathToFull(DiskPath));
+			}
+
+			if (VirtualPath.StartsWith(TEXT("/Engine/")))
+			{
+				return;
+			}
+
+			const FHLSLIncludeCacheEntry* Entry = FindOrUpdateEntry(DiskPath);
+			if (!Entry)
+			{
+				return;
+			}
+
+			// Copy, visiting might update other entries
+			const TArray<FString> Includes = Entry->Includes;
+			const FString VirtualFolder = FPaths::GetPath(VirtualPath);
+
+			Stack.Add(VirtualPath);
+			for (const FString& Include : Includes)
+			{
+				Visit(Include.StartsWith(TEXT("/")) ? Include : VirtualFolder / Include, true);
+			}
+			Stack.Pop();
+		}
+	};
+}
+
+bool FHLSLMaterialIncludeCache::GetHash(const FString& DiskPath, FHLSLHash& OutHash)
+{
+	const FHLSLIncludeCacheEntry* Entry = FindOrUpdateEntry(DiskPath);
+	if (!Entry)
+	{
+		return false;
+	}
+
+	OutHash = Entry->Hash;
+	return true;
+}
+
+void FHLSLMaterialIncludeCache::Invalidate(const FString& DiskPath)
+{
+	check(IsInGameThread());
+
+	if (FHLSLIncludeCacheEntry* Entry = GHLSLIncludeCache.Find(FPaths::ConvertRelativePathToFull(DiskPath)))
+	{
+		Entry->bStale = true;
+	}
+}
+
+TArray<FString> FHLSLMaterialIncludeCache::GetNestedIncludes(const TArray<FString>& VirtualPaths)
+{
+	FHLSLIncludeVisitor Visitor;
+	for (const FString& VirtualPath : VirtualPaths)
+	{
+		Visitor.Visit(VirtualPath, false);
+	}
+	return MoveTemp(Visitor.NestedDiskPaths);
+}
+
+TSet<FString> FHLSLMaterialIncludeCache::GetIdentifiers(const TArray<FString>& VirtualPaths)
+{
+	TArray<FString> DiskPaths;
+	for (const FString& VirtualPath : VirtualPaths)
+	{
+		DiskPaths.Add(GetShaderSourceFilePath(VirtualPath));
+	}
+	DiskPaths.Append(GetNestedIncludes(VirtualPaths));
+
+	TSet<FString> Identifiers;
+	for (const FString& DiskPath : DiskPaths)
+	{
+		if (const FHLSLIncludeCacheEntry* Entry = FindOrUpdateEntry(DiskPath))
+		{
+			Identifiers.Append(Entry->Identifiers);
+		}
+	}
+	return Identifiers;
+}
+
+bool FHLSLMaterialIncludeCache::ConsumeChanges()
+{
+	check(IsInGameThread());
+
+	const bool bChanged = GHLSLIncludesChanged;
+	GHLSLIncludesChanged = false;
+	return bChanged;
+}
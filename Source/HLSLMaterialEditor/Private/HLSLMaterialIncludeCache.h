@@ -0,0 +1,26 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HLSLMaterialUtilities.h"
+
+// Digests & includes of the included files, shared by all the libraries
+// A file is only read & hashed again if its timestamp or size changed, or if a directory watcher reported it modified
+class HLSLMATERIALEDITOR_API FHLSLMaterialIncludeCache
+{
+public:
+	// False if the file can't be read
+	static bool GetHash(const FString& DiskPath, FHLSLHash& OutHash);
+	static void Invalidate(const FString& DiskPath);
+
+	// Disk paths of the files included by these ones, directly or not, each once
+	// Engine shaders are not followed: they don't change under our feet, and including one pulls half of them
+	// Cycles are logged & broken
+	static TArray<FString> GetNestedIncludes(const TArray<FString>& VirtualPaths);
+	// Words used by these files & by all the files they include, eg to know which defines they might read
+	static TSet<FString> GetIdentifiers(const TArray<FString>& VirtualPaths);
+
+	// True if the content of an include changed since the last call
+	static bool ConsumeChanges();
+};
@@ -0,0 +1,38 @@
+// Copyright Phyronnaz
+
+#include "HLSLMaterialPackageStamp.h"
+#include "HLSLMaterialUtilities.h"
+#include "HAL/FileManager.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+FString FHLSLMaterialPackageStamp::Get(const TArray<FString>& LongPackageNames)
+{
+	FHLSLHashBuilder HashBuilder;
+	for (const FString& LongPackageName : LongPackageNames)
+	{
+		// What's on disk is not what will be used
+		const UPackage* Package = FindPackage(nullptr, *LongPackageName);
+		if (Package && Package->IsDirty())
+		{
+			return {};
+		}
+
+		FString Filename;
+		if (!FPackageName::TryConvertLongPackageNameToFilename(LongPackageName, Filename, FPackageName::GetAssetPackageExtension()))
+		{
+			return {};
+		}
+
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*Filename);
+		if (!StatData.bIsValid)
+		{
+			return {};
+		}
+
+		HashBuilder.Update(LongPackageName);
+		HashBuilder.Update(&StatData.ModificationTime, sizeof(FDateTime));
+		HashBuilder.Update(&StatData.FileSize, sizeof(int64));
+	}
+	return HashBuilder.Finalize().ToString();
+}
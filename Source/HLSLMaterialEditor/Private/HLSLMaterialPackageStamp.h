@@ -0,0 +1,15 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Identifies the saved state of generated packages, without loading them
+// Libraries store it next to their fingerprint: if the packages were reverted, edited or never saved since, the stamp differs
+// and the generated assets must be loaded to check their hash comments
+class HLSLMATERIALEDITOR_API FHLSLMaterialPackageStamp
+{
+public:
+	// Empty if a package doesn't exist on disk or has unsaved changes: nothing can be trusted then
+	static FString Get(const TArray<FString>& LongPackageNames);
+};
@@ -1,312 +1,53 @@
 ﻿// Copyright Phyronnaz
 
 #include "HLSLMaterialParser.h"
+#include "HLSLParser.h"
 #include "HLSLMaterialFunction.h"
 #include "HLSLMaterialFunctionLibrary.h"
 #include "HLSLMaterialMessages.h"
-#include "Internationalization/Regex.h"
 #include "ShaderCompilerCore.h"
 
 FString FHLSLMaterialParser::Parse(
 	const UHLSLMaterialFunctionLibrary& Library, 
 	FString Text, 
 	TArray<FHLSLMaterialFunction>& OutFunctions,
-	TArray<FString>& OutStructs)
+	TArray<FHLSLParsedStruct>& OutStructs)
 {
-	enum class EScope
-	{
-		Global,
-		Preprocessor,
-		FunctionComment,
-		FunctionMetadata,
-		FunctionReturn,
-		FunctionName,
-		FunctionArgs,
-		FunctionBodyStart,
-		FunctionBody,
-		Struct
-	};
-
-	EScope Scope = EScope::Global;
-	int32 Index = 0;
-	int32 ScopeDepth = 0;
-	int32 ArgParenthesisScopeDepth = 0;
-	int32 ArgBracketScopeDepth = 0;
-	int32 LineNumber = 0;
-
-	// Simplify line breaks handling
-	Text.ReplaceInline(TEXT("\r\n"), TEXT("\n"));
+	FHLSLParseOptions Options;
+	Options.bAccurateErrors = Library.bAccurateErrors;
 
-	while (Index < Text.Len())
+	TArray<FHLSLParsedFunction> Functions;
+	const FString Error = GetIncrementalParser(Library).Parse(Options, MoveTemp(Text), Functions, OutStructs);
+	if (!Error.IsEmpty())
 	{
-		FString Token;
-		for (int32 TokenIndex = Index; TokenIndex < Text.Len() && !FChar::IsWhitespace(Text[TokenIndex]); TokenIndex++)
-		{
-			Token += Text[TokenIndex];
-		}
-		
-		const TCHAR Char = Text[Index++];
-		
-		if (FChar::IsLinebreak(Char))
-		{
-			LineNumber++;
-		}
-
-		switch (Scope)
-		{
-		case EScope::Global:
-		{
-			ensure(ScopeDepth == 0);
-			ensure(ArgParenthesisScopeDepth == 0);
-
-			if (FChar::IsLinebreak(Char))
-			{
-				// Clear any pending comment when there's an empty line with no //
-				if (OutFunctions.Num() > 0 && 
-					OutFunctions.Last().ReturnType.IsEmpty())
-				{
-					OutFunctions.Pop();
-				}
-				continue;
-			}
-			if (FChar::IsWhitespace(Char))
-			{
-				continue;
-			}
-
-			if (OutFunctions.Num() == 0 || !OutFunctions.Last().ReturnType.IsEmpty())
-			{
-				OutFunctions.Emplace();
-			}
-			Index--;
-
-			if (Char == TEXT('#'))
-			{
-				Scope = EScope::Preprocessor;
-			}
-			else if (Char == TEXT('/'))
-			{
-				Scope = EScope::FunctionComment;
-			}
-			else if (Char == TEXT('['))
-			{
-				Scope = EScope::FunctionMetadata;
-			}
-			else if (Token == TEXT("struct"))
-			{
-				Scope = EScope::Struct;
-				OutStructs.Emplace();
-			}
-			else
-			{
-				Scope = EScope::FunctionReturn;
-			}
-		}
-		break;
-		case EScope::Preprocessor:
-		{
-			if (!FChar::IsLinebreak(Char))
-			{
-				continue;
-			}
-
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::FunctionComment:
-		{
-			if (!FChar::IsLinebreak(Char))
-			{
-				OutFunctions.Last().Comment += Char;
-				continue;
-			}
-			OutFunctions.Last().Comment += "\n";
-
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::FunctionMetadata:
-		{
-			if (!FChar::IsLinebreak(Char))
-			{
-				OutFunctions.Last().Metadata += Char;
-				continue;
-			}
-			OutFunctions.Last().Metadata += "\n";
-
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::FunctionReturn:
-		{
-			if (!FChar::IsWhitespace(Char))
-			{
-				OutFunctions.Last().ReturnType += Char;
-				continue;
-			}
-
-			Scope = EScope::FunctionName;
-		}
-		break;
-		case EScope::FunctionName:
-		{
-			if (Char != TEXT('('))
-			{
-				if (!FChar::IsWhitespace(Char))
-				{
-					OutFunctions.Last().Name += Char;
-				}
-				continue;
-			}
-
-			Scope = EScope::FunctionArgs;
-
-			ensure(ArgParenthesisScopeDepth == 0);
-			ArgParenthesisScopeDepth++;
-
-			ArgBracketScopeDepth = 0;
-		}
-		break;
-		case EScope::FunctionArgs:
-		{
-			if (Char == TEXT('('))
-			{
-				ArgParenthesisScopeDepth++;
-			}
-			else if (Char == TEXT(')'))
-			{
-				ArgParenthesisScopeDepth--;
-				ensure(ArgParenthesisScopeDepth >= 0);
-			}
-
-			if (Char == TEXT('['))
-			{
-				ArgBracketScopeDepth++;
-			}
-			else if (Char == TEXT(']'))
-			{
-				ArgBracketScopeDepth--;
-			}
-
-			if (ArgParenthesisScopeDepth > 0)
-			{
-				if (Char == TEXT(',') &&
-					ArgBracketScopeDepth == 0 &&
-					ArgParenthesisScopeDepth == 1)
-				{
-					OutFunctions.Last().Arguments.Emplace();
-				}
-				else
-				{
-					if (OutFunctions.Last().Arguments.Num() == 0)
-					{
-						OutFunctions.Last().Arguments.Emplace();
-					}
-
-					OutFunctions.Last().Arguments.Last() += Char;
-				}
-				continue;
-			}
-
-			ensure(ArgParenthesisScopeDepth == 0);
-			Scope = EScope::FunctionBodyStart;
-		}
-		break;
-		case EScope::FunctionBodyStart:
-		{
-			ensure(ScopeDepth == 0);
-
-			if (FChar::IsWhitespace(Char))
-			{
-				continue;
-			}
-
-			if (Char != TEXT('{'))
-			{
-				return FString::Printf(TEXT("Invalid function body for %s: missing {"), *OutFunctions.Last().Name);
-			}
-
-			if (Library.bAccurateErrors)
-			{
-				OutFunctions.Last().StartLine = LineNumber;
-			}
-
-			Scope = EScope::FunctionBody;
-			ScopeDepth++;
-		}
-		break;
-		case EScope::FunctionBody:
-		{
-			ensure(ScopeDepth > 0);
-
-			if (Char == TEXT('{'))
-			{
-				ScopeDepth++;
-			}
-			if (Char == TEXT('}'))
-			{
-				ScopeDepth--;
-			}
-
-			if (ScopeDepth > 0)
-			{
-				OutFunctions.Last().Body += Char;
-				continue;
-			}
-			if (ScopeDepth < 0)
-			{
-				return FString::Printf(TEXT("Invalid function body for %s: too many }"), *OutFunctions.Last().Name);
-			}
+		return Error;
+	}
 
-			ensure(ScopeDepth == 0);
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::Struct:
-		{
-			OutStructs.Last() += Char;
+	for (FHLSLParsedFunction& Function : Functions)
+	{
+		static_cast<FHLSLParsedFunction&>(OutFunctions.Emplace_GetRef()) = MoveTemp(Function);
+	}
 
-			if (Char == TEXT('{'))
-			{
-				ScopeDepth++;
-			}
-			if (Char == TEXT('}'))
-			{
-				ScopeDepth--;
-			}
+	return {};
+}
 
-			if (ScopeDepth == 0 && Char == TEXT(';'))
-			{
-				Scope = EScope::Global;
-			}
-		}
-		break;
-		default: ensure(false);
-		}
-	}
+FHLSLIncrementalParser& FHLSLMaterialParser::GetIncrementalParser(const UHLSLMaterialFunctionLibrary& Library)
+{
+	static TMap<TWeakObjectPtr<const UHLSLMaterialFunctionLibrary>, FHLSLIncrementalParser> Parsers;
 
-	if (Scope == EScope::FunctionComment)
+	// Forget deleted libraries
+	for (auto It = Parsers.CreateIterator(); It; ++It)
 	{
-		// Can have a commented out function at the end
-		if (ensure(OutFunctions.Num() > 0) &&
-			ensure(OutFunctions.Last().ReturnType.IsEmpty()))
+		if (!It.Key().IsValid())
 		{
-			OutFunctions.Pop();
-			Scope = EScope::Global;
+			It.RemoveCurrent();
 		}
 	}
 
-	if (Scope != EScope::Global)
-	{
-		return TEXT("Parsing error");
-	}
-	ensure(ScopeDepth == 0);
-	ensure(ArgParenthesisScopeDepth == 0);
-
-	return {};
+	return Parsers.FindOrAdd(&Library);
 }
 
-TArray<FHLSLMaterialParser::FInclude> FHLSLMaterialParser::GetIncludes(const FString& FilePath, const FString& Text)
+void FHLSLMaterialParser::GetDirectives(const FString& FilePath, const FString& Text, TArray<FInclude>& OutIncludes, TArray<FCustomDefine>& OutDefines)
 {
 	FString VirtualFolder;
 	if (UHLSLMaterialFunctionLibrary::TryConvertFilenameToShaderPath(FilePath, VirtualFolder))
@@ -314,13 +55,11 @@ TArray<FHLSLMaterialParser::FInclude> FHLSLMaterialParser::GetIncludes(const FSt
 		VirtualFolder = FPaths::GetPath(VirtualFolder);
 	}
 
-	TArray<FInclude> OutIncludes;
+	const FHLSLParsedDirectives Directives = FHLSLParser::GetDirectives(Text);
 
-	FRegexPattern RegexPattern(R"_((\A|\v)\s*#include "([^"]+)")_");
-	FRegexMatcher RegexMatcher(RegexPattern, Text);
-	while (RegexMatcher.FindNext())
+	for (const FHLSLParsedInclude& Include : Directives.Includes)
 	{
-		FString VirtualPath = RegexMatcher.GetCaptureGroup(2);
+		FString VirtualPath = Include.Path;
 		if (!VirtualPath.StartsWith(TEXT("/")) && !VirtualFolder.IsEmpty())
 		{
 			// Relative path
@@ -330,29 +69,26 @@ TArray<FHLSLMaterialParser::FInclude> FHLSLMaterialParser::GetIncludes(const FSt
 		FString DiskPath = GetShaderSourceFilePath(VirtualPath);
 		if (DiskPath.IsEmpty())
 		{
-			FHLSLMaterialMessages::ShowError(TEXT("Failed to map include %s"), *VirtualPath);
+			FHLSLMaterialMessages::ShowError(TEXT("Failed to map include %s (line %d)"), *VirtualPath, Include.Line);
 		}
 		else
 		{
 			DiskPath = FPaths::ConvertRelativePathToFull(DiskPath);
 		}
 
-		OutIncludes.Add({ VirtualPath, DiskPath });
+		OutIncludes.Add({ VirtualPath, DiskPath, Include.Line });
 	}
 
-	return OutIncludes;
-}
-
-TArray<FCustomDefine> FHLSLMaterialParser::GetDefines(const FString& Text)
-{
-	TArray<FCustomDefine> OutDefines;
-
-	FRegexPattern RegexPattern(R"_((\A|\v)\s*#define (\w*) (.*))_");
-	FRegexMatcher RegexMatcher(RegexPattern, Text);
-	while (RegexMatcher.FindNext())
+	for (const FHLSLParsedDefine& Define : Directives.Defines)
 	{
-		OutDefines.Add({ RegexMatcher.GetCaptureGroup(2), RegexMatcher.GetCaptureGroup(3) });
+		OutDefines.Add({ Define.Name, Define.Value });
 	}
+}
 
-	return OutDefines;
-}
\ No newline at end of file
+TArray<FHLSLMaterialParser::FInclude> FHLSLMaterialParser::GetIncludes(const FString& FilePath, const FString& Text)
+{
+	TArray<FInclude> OutIncludes;
+	TArray<FCustomDefine> Defines;
+	GetDirectives(FilePath, Text, OutIncludes, Defines);
+	return OutIncludes;
+}
@@ -6,6 +6,8 @@
 
 struct FCustomDefine;
 struct FHLSLMaterialFunction;
+struct FHLSLParsedStruct;
+class FHLSLIncrementalParser;
 class UHLSLMaterialFunctionLibrary;
 
 class FHLSLMaterialParser
@@ -15,13 +17,18 @@ public:
 		const UHLSLMaterialFunctionLibrary& Library, 
 		FString Text, 
 		TArray<FHLSLMaterialFunction>& OutFunctions,
-		TArray<FString>& OutStructs);
+		TArray<FHLSLParsedStruct>& OutStructs);
+
+	// Keeps the last parse of each library, so that only the declarations edited since are reparsed
+	static FHLSLIncrementalParser& GetIncrementalParser(const UHLSLMaterialFunctionLibrary& Library);
 
 	struct FInclude
 	{
 		FString VirtualPath;
 		FString DiskPath;
+		int32 Line = 0;
 	};
+	// Includes & defines are collected in a single pass
+	static void GetDirectives(const FString& FilePath, const FString& Text, TArray<FInclude>& OutIncludes, TArray<FCustomDefine>& OutDefines);
 	static TArray<FInclude> GetIncludes(const FString& FilePath, const FString& Text);
-	static TArray<FCustomDefine> GetDefines(const FString& Text);
 };
\ No newline at end of file
@@ -0,0 +1,13 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+
+// Temporaries of a single generation, allocated on the thread's FMemStack
+// Freed all at once when the FMemMark of the generation is popped: they must not outlive it
+template<typename T>
+using THLSLTempArray = TArray<T, TMemStackAllocator<>>;
+template<typename KeyType, typename ValueType>
+using THLSLTempMap = TMap<KeyType, ValueType, TSetAllocator<TSparseArrayAllocator<TMemStackAllocator<>, TMemStackAllocator<>>, TMemStackAllocator<>>>;
@@ -28,6 +28,12 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Config", meta = (DisplayName = "HLSL Editor Args"))
 	FString HLSLEditorArgs = "-g \"%FILE%:%LINE%:%CHAR%\"";
 
+	// If true, the code of the generated custom nodes is kept as written, with its comments & the hash of the function
+	// Easier to read when debugging the generated shaders, and error columns are accurate
+	// But any comment or formatting edit then changes the material & recompiles all its permutations
+	UPROPERTY(Config, EditAnywhere, Category = "Config")
+	bool bReadableGeneratedCode = false;
+
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override
 	{
 		Super::PostEditChangeProperty(PropertyChangedEvent);
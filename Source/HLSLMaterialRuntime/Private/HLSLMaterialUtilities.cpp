@@ -2,10 +2,198 @@
 
 #include "HLSLMaterialUtilities.h"
 #include "Containers/Ticker.h"
-#include "Misc/SecureHash.h"
 
 DEFINE_LOG_CATEGORY(LogHLSLMaterial);
 
+namespace
+{
+	constexpr uint64 MurmurC1 = 0x87c37b91114253d5ull;
+	constexpr uint64 MurmurC2 = 0x4cf5ad432745937full;
+
+	FORCEINLINE uint64 RotateLeft(const uint64 Value, const int32 Shift)
+	{
+		return (Value << Shift) | (Value >> (64 - Shift));
+	}
+	FORCEINLINE uint64 MixK1(uint64 K1)
+	{
+		K1 *= MurmurC1;
+		K1 = RotateLeft(K1, 31);
+		K1 *= MurmurC2;
+		return K1;
+	}
+	FORCEINLINE uint64 MixK2(uint64 K2)
+	{
+		K2 *= MurmurC2;
+		K2 = RotateLeft(K2, 33);
+		K2 *= MurmurC1;
+		return K2;
+	}
+	FORCEINLINE uint64 FinalMix(uint64 Value)
+	{
+		Value ^= Value >> 33;
+		Value *= 0xff51afd7ed558ccdull;
+		Value ^= Value >> 33;
+		Value *= 0xc4ceb9fe1a85ec53ull;
+		Value ^= Value >> 33;
+		return Value;
+	}
+	FORCEINLINE uint64 ReadUint64(const uint8* Data)
+	{
+		// Little endian on every platform we ship on, and unaligned reads are fine with memcpy
+		uint64 Value;
+		FMemory::Memcpy(&Value, Data, sizeof(uint64));
+		return Value;
+	}
+}
+
+FString FHLSLHash::ToString() const
+{
+	return FString::Printf(TEXT("%016llx%016llx"), A, B);
+}
+
+void FHLSLHashBuilder::Update(const void* Data, const int64 Size)
+{
+	const uint8* Bytes = static_cast<const uint8*>(Data);
+	int64 Remaining = Size;
+	TotalSize += Size;
+
+	// Complete the pending block first
+	if (TailSize > 0)
+	{
+		const int32 NumToCopy = int32(FMath::Min<int64>(BlockSize - TailSize, Remaining));
+		FMemory::Memcpy(Tail + TailSize, Bytes, NumToCopy);
+		TailSize += NumToCopy;
+		Bytes += NumToCopy;
+		Remaining -= NumToCopy;
+
+		if (TailSize < BlockSize)
+		{
+			return;
+		}
+		ProcessBlock(Tail);
+		TailSize = 0;
+	}
+
+	for (; Remaining >= BlockSize; Remaining -= BlockSize, Bytes += BlockSize)
+	{
+		ProcessBlock(Bytes);
+	}
+
+	FMemory::Memcpy(Tail, Bytes, Remaining);
+	TailSize = int32(Remaining);
+}
+
+void FHLSLHashBuilder::Update(const FStringView String)
+{
+	Update(String.GetData(), String.Len() * sizeof(TCHAR));
+
+	const int64 Length = String.Len();
+	Update(&Length, sizeof(Length));
+}
+
+void FHLSLHashBuilder::Update(const FHLSLHash& Hash)
+{
+	Update(&Hash.A, sizeof(Hash.A));
+	Update(&Hash.B, sizeof(Hash.B));
+}
+
+FHLSLHash FHLSLHashBuilder::Finalize() const
+{
+	uint64 Final1 = H1;
+	uint64 Final2 = H2;
+
+	uint64 K1 = 0;
+	uint64 K2 = 0;
+	for (int32 Index = TailSize - 1; Index >= 0; Index--)
+	{
+		if (Index >= 8)
+		{
+			K2 = (K2 << 8) | Tail[Index];
+		}
+		else
+		{
+			K1 = (K1 << 8) | Tail[Index];
+		}
+	}
+	if (TailSize > 8)
+	{
+		Final2 ^= MixK2(K2);
+	}
+	if (TailSize > 0)
+	{
+		Final1 ^= MixK1(K1);
+	}
+
+	Final1 ^= TotalSize;
+	Final2 ^= TotalSize;
+
+	Final1 += Final2;
+	Final2 += Final1;
+
+	Final1 = FinalMix(Final1);
+	Final2 = FinalMix(Final2);
+
+	Final1 += Final2;
+	Final2 += Final1;
+
+	return { Final1, Final2 };
+}
+
+void FHLSLHashBuilder::ProcessBlock(const uint8* Block)
+{
+	H1 ^= MixK1(ReadUint64(Block));
+	H1 = RotateLeft(H1, 27);
+	H1 += H2;
+	H1 = H1 * 5 + 0x52dce729;
+
+	H2 ^= MixK2(ReadUint64(Block + 8));
+	H2 = RotateLeft(H2, 31);
+	H2 += H1;
+	H2 = H2 * 5 + 0x38495ab5;
+}
+
+void FHLSLWhitespaceCollapsingHasher::Update(const FStringView Text)
+{
+	static const TCHAR Space = TEXT(' ');
+
+	// Hash the runs without whitespace in one go
+	int32 RunStart = 0;
+	const auto FlushRun = [&](const int32 RunEnd)
+	{
+		if (RunEnd > RunStart)
+		{
+			Builder.Update(Text.GetData() + RunStart, (RunEnd - RunStart) * sizeof(TCHAR));
+			Length += RunEnd - RunStart;
+			bLastIsSpace = false;
+		}
+	};
+
+	for (int32 Index = 0; Index < Text.Len(); Index++)
+	{
+		const TCHAR Char = Text[Index];
+		if (Char != TEXT(' ') && Char != TEXT('\t') && Char != TEXT('\n'))
+		{
+			continue;
+		}
+
+		FlushRun(Index);
+		RunStart = Index + 1;
+
+		if (!bLastIsSpace)
+		{
+			Builder.Update(&Space, sizeof(TCHAR));
+			Length++;
+			bLastIsSpace = true;
+		}
+	}
+	FlushRun(Text.Len());
+}
+
+void FHLSLWhitespaceCollapsingHasher::Finish()
+{
+	Builder.Update(&Length, sizeof(Length));
+}
+
 void FHLSLMaterialUtilities::DelayedCall(TFunction<void()> Call, float Delay)
 {
 	check(IsInGameThread());
@@ -17,11 +205,9 @@ void FHLSLMaterialUtilities::DelayedCall(TFunction<void()> Call, float Delay)
 	}), Delay);
 }
 
-FString FHLSLMaterialUtilities::HashString(const FString& String)
+FHLSLHash FHLSLMaterialUtilities::HashString(const FStringView String)
 {
-	uint32 Hash[5];
-	const TArray<TCHAR>& Array = String.GetCharArray();
-	FSHA1::HashBuffer(Array.GetData(), Array.Num() * Array.GetTypeSize(), reinterpret_cast<uint8*>(Hash));
-
-	return FGuid(Hash[0] ^ Hash[4], Hash[1], Hash[2], Hash[3]).ToString();
-}
\ No newline at end of file
+	FHLSLHashBuilder Builder;
+	Builder.Update(String);
+	return Builder.Finalize();
+}
@@ -59,8 +59,8 @@ public:
 	//
 	// ie, errors will look like MyFile.hlsl:9 instead of /Generated/Material.usf:2330
 	// 
-	// The downside is that whenever you add or remove a line to your file, all the functions below it will have to be recompiled
-	// If compilation is taking forever for you, consider turning this off
+	// Lines are relative to each function and mapped back to the file when displaying the error,
+	// so adding or removing a line to your file doesn't recompile the functions below it
 	UPROPERTY(EditAnywhere, Category = "Config")
 	bool bAccurateErrors = true;
 
@@ -72,6 +72,16 @@ public:
 
 	UPROPERTY(EditAnywhere, Category = "Generated")
 	TArray<TSoftObjectPtr<UMaterialFunction>> MaterialFunctions;
+
+	// Fingerprint of the source MaterialFunctions were last generated from
+	// Searchable so that stale libraries can be found from the asset registry, without loading the functions
+	UPROPERTY(VisibleAnywhere, Category = "Generated", AssetRegistrySearchable)
+	FString GeneratedFingerprint;
+
+	// Saved state of MaterialFunctions when they were last found matching GeneratedFingerprint
+	// If a function was reverted or edited since, they are loaded to check their hash comments
+	UPROPERTY()
+	FString GeneratedPackageStamp;
 #endif
 
 #if WITH_EDITOR
@@ -5,12 +5,83 @@
 #include "CoreMinimal.h"
 #include "Runtime/Launch/Resources/Version.h"
 
+// 128-bit digest of some content, only meant for change detection
+struct HLSLMATERIALRUNTIME_API FHLSLHash
+{
+	uint64 A = 0;
+	uint64 B = 0;
+
+	bool IsZero() const
+	{
+		return A == 0 && B == 0;
+	}
+	// 32 hex chars
+	FString ToString() const;
+
+	bool operator==(const FHLSLHash& Other) const
+	{
+		return A == Other.A && B == Other.B;
+	}
+	bool operator!=(const FHLSLHash& Other) const
+	{
+		return !(*this == Other);
+	}
+	friend uint32 GetTypeHash(const FHLSLHash& Hash)
+	{
+		return uint32(Hash.A);
+	}
+};
+
+// Streaming MurmurHash3 x64 128: not cryptographic, but several GB/s and no intermediate buffer
+// The digest doesn't depend on how the bytes are split across the Update calls
+class HLSLMATERIALRUNTIME_API FHLSLHashBuilder
+{
+public:
+	void Update(const void* Data, int64 Size);
+	// The chars followed by their count, so that "ab" + "c" and "a" + "bc" differ
+	void Update(FStringView String);
+	void Update(const FHLSLHash& Hash);
+
+	FHLSLHash Finalize() const;
+
+private:
+	static constexpr int32 BlockSize = 16;
+
+	uint64 H1 = 0;
+	uint64 H2 = 0;
+	uint64 TotalSize = 0;
+	uint8 Tail[BlockSize];
+	int32 TailSize = 0;
+
+	void ProcessBlock(const uint8* Block);
+};
+
+// Feeds text to a builder as if tabs & line breaks were spaces and runs of spaces were a single one, even across Update calls
+// Same digest as collapsing the concatenated text & passing it to FHLSLHashBuilder::Update(FStringView), without building that string
+class HLSLMATERIALRUNTIME_API FHLSLWhitespaceCollapsingHasher
+{
+public:
+	explicit FHLSLWhitespaceCollapsingHasher(FHLSLHashBuilder& Builder)
+		: Builder(Builder)
+	{
+	}
+
+	void Update(FStringView Text);
+	// Appends the collapsed length, must be called once after the last Update
+	void Finish();
+
+private:
+	FHLSLHashBuilder& Builder;
+	int64 Length = 0;
+	bool bLastIsSpace = false;
+};
+
 struct HLSLMATERIALRUNTIME_API FHLSLMaterialUtilities
 {
 	// Delay until next fire; 0 means "next frame"
 	static void DelayedCall(TFunction<void()> Call, float Delay = 0);
 
-	static FString HashString(const FString& String);
+	static FHLSLHash HashString(FStringView String);
 };
 
 HLSLMATERIALRUNTIME_API DECLARE_LOG_CATEGORY_EXTERN(LogHLSLMaterial, Log, All);
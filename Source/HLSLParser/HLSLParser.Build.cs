@@ -0,0 +1,26 @@
+// Copyright Phyronnaz
+
+using System.IO;
+using UnrealBuildTool;
+
+public class HLSLParser : ModuleRules
+{
+    public HLSLParser(ReadOnlyTargetRules Target) : base(Target)
+    {
+        PCHUsage = PCHUsageMode.NoPCHs;
+
+        bLegacyPublicIncludePaths = false;
+        bUseUnity = false;
+
+        PublicIncludePaths.Add(Path.Combine(ModuleDirectory, "Public"));
+        PrivateIncludePaths.Add(Path.Combine(ModuleDirectory, "Private"));
+
+        // Core only: the parser must stay usable without any UObject, asset or editor module
+        PublicDependencyModuleNames.AddRange(
+            new string[]
+            {
+                "Core",
+            }
+        );
+    }
+}
@@ -0,0 +1,198 @@
+// Copyright Phyronnaz
+
+#include "HLSLLexer.h"
+
+FString FHLSLLexer::Tokenize(const FStringView Text, TArray<FHLSLToken>& OutTokens)
+{
+	const TCHAR* const Chars = Text.GetData();
+	const int32 Num = Text.Len();
+
+	// Tokens are rarely shorter than that, avoids most reallocations
+	OutTokens.Reserve(OutTokens.Num() + Num / 4);
+
+	int32 Index = 0;
+	int32 Line = 1;
+	int32 LineStart = 0;
+	// True until we find something that's not whitespace on the current line
+	bool bLineStart = true;
+
+	const auto IsLinebreak = [&](const int32 InIndex)
+	{
+		// Lone \r are line breaks too, \r\n is only counted once
+		return
+			Chars[InIndex] == TEXT('\n') ||
+			(Chars[InIndex] == TEXT('\r') && (InIndex + 1 >= Num || Chars[InIndex + 1] != TEXT('\n')));
+	};
+	const auto NewLine = [&]
+	{
+		Line++;
+		LineStart = Index;
+		bLineStart = true;
+	};
+	const auto IsIdentifierChar = [](const TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_');
+	};
+
+	while (Index < Num)
+	{
+		const TCHAR Char = Chars[Index];
+
+		if (IsLinebreak(Index))
+		{
+			Index++;
+			NewLine();
+			continue;
+		}
+		if (FChar::IsWhitespace(Char))
+		{
+			Index++;
+			continue;
+		}
+
+		FHLSLToken Token;
+		Token.Start = Index;
+		Token.Line = Line;
+		Token.Column = Index - LineStart + 1;
+
+		const TCHAR NextChar = Index + 1 < Num ? Chars[Index + 1] : TEXT('\0');
+
+		if (Char == TEXT('#') && bLineStart)
+		{
+			Token.Type = EHLSLTokenType::Preprocessor;
+
+			// Stop right before the line break, unless it's escaped
+			while (Index < Num)
+			{
+				if (IsLinebreak(Index))
+				{
+					int32 Previous = Index - 1;
+					if (Previous >= 0 && Chars[Previous] == TEXT('\r'))
+					{
+						Previous--;
+					}
+					if (Previous < 0 || Chars[Previous] != TEXT('\\'))
+					{
+						break;
+					}
+					Index++;
+					NewLine();
+					continue;
+				}
+				Index++;
+			}
+		}
+		else if (Char == TEXT('/') && NextChar == TEXT('/'))
+		{
+			Token.Type = EHLSLTokenType::Comment;
+
+			while (Index < Num && !IsLinebreak(Index) && Chars[Index] != TEXT('\r'))
+			{
+				Index++;
+			}
+		}
+		else if (Char == TEXT('/') && NextChar == TEXT('*'))
+		{
+			Token.Type = EHLSLTokenType::Comment;
+
+			Index += 2;
+			while (Index < Num && !(Chars[Index] == TEXT('*') && Index + 1 < Num && Chars[Index + 1] == TEXT('/')))
+			{
+				if (IsLinebreak(Index++))
+				{
+					NewLine();
+				}
+			}
+			if (Index >= Num)
+			{
+				return FString::Printf(TEXT("Unterminated comment starting at line %d, column %d"), Token.Line, Token.Column);
+			}
+			Index += 2;
+		}
+		else if (Char == TEXT('"'))
+		{
+			Token.Type = EHLSLTokenType::String;
+
+			Index++;
+			while (Index < Num && Chars[Index] != TEXT('"'))
+			{
+				if (IsLinebreak(Index))
+				{
+					return FString::Printf(TEXT("Unterminated string starting at line %d, column %d"), Token.Line, Token.Column);
+				}
+				// Skip escaped characters
+				if (Chars[Index] == TEXT('\\'))
+				{
+					Index++;
+					// Escaped line break, the string continues on the next line
+					if (Index < Num && Chars[Index] == TEXT('\r') && !IsLinebreak(Index))
+					{
+						Index++;
+					}
+					if (Index < Num && IsLinebreak(Index))
+					{
+						Index++;
+						NewLine();
+						continue;
+					}
+				}
+				Index++;
+			}
+			if (Index >= Num)
+			{
+				return FString::Printf(TEXT("Unterminated string starting at line %d, column %d"), Token.Line, Token.Column);
+			}
+			Index++;
+		}
+		else if (FChar::IsDigit(Char) || (Char == TEXT('.') && FChar::IsDigit(NextChar)))
+		{
+			Token.Type = EHLSLTokenType::Number;
+
+			while (Index < Num)
+			{
+				const TCHAR NumberChar = Chars[Index];
+				if (IsIdentifierChar(NumberChar) || NumberChar == TEXT('.'))
+				{
+					Index++;
+				}
+				else if (
+					(NumberChar == TEXT('+') || NumberChar == TEXT('-')) &&
+					(Chars[Index - 1] == TEXT('e') || Chars[Index - 1] == TEXT('E')))
+				{
+					// Exponent sign. Hex literals don't have exponents, so 0x1e+1 is still an addition
+					if (Index - Token.Start >= 2 && (Chars[Token.Start + 1] == TEXT('x') || Chars[Token.Start + 1] == TEXT('X')))
+					{
+						break;
+					}
+					Index++;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+		else if (IsIdentifierChar(Char))
+		{
+			Token.Type = EHLSLTokenType::Identifier;
+
+			while (Index < Num && IsIdentifierChar(Chars[Index]))
+			{
+				Index++;
+			}
+		}
+		else
+		{
+			Token.Type = EHLSLTokenType::Punctuation;
+			Index++;
+		}
+
+		Token.Length = Index - Token.Start;
+		Token.EndLine = Line;
+		OutTokens.Add(Token);
+
+		bLineStart = false;
+	}
+
+	return {};
+}
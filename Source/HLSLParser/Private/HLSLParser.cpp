@@ -0,0 +1,1557 @@
+// Copyright Phyronnaz
+
+#include "HLSLParser.h"
+#include "HLSLLexer.h"
+#include "Misc/Parse.h"
+
+namespace
+{
+	// Parses the top-level declarations in [RangeStart, RangeEnd) of Source and appends them to OutResult
+	// RangeStart must be the start of line FirstLine
+	// OutPendingEndLine is the last line of the comments & metadata left unattached at the end of the range, INDEX_NONE if none
+	FString ParseDeclarations(
+		const FHLSLParseOptions& Options,
+		const TSharedRef<const FString>& Source,
+		const int32 RangeStart,
+		const int32 RangeEnd,
+		const int32 FirstLine,
+		FHLSLParseResult& OutResult,
+		int32& OutPendingEndLine)
+	{
+		OutPendingEndLine = INDEX_NONE;
+
+		const FString& SourceText = *Source;
+
+		TArray<FHLSLToken> Tokens;
+		{
+			const FString Error = FHLSLLexer::Tokenize(FStringView(*SourceText + RangeStart, RangeEnd - RangeStart), Tokens);
+			if (!Error.IsEmpty())
+			{
+				return Error;
+			}
+		}
+		// Make the tokens relative to the whole source
+		if (RangeStart != 0 || FirstLine != 1)
+		{
+			for (FHLSLToken& Token : Tokens)
+			{
+				Token.Start += RangeStart;
+				Token.Line += FirstLine - 1;
+				Token.EndLine += FirstLine - 1;
+			}
+		}
+
+		const auto IsPunctuation = [&](const int32 TokenIndex, const TCHAR Char)
+		{
+			return Tokens.IsValidIndex(TokenIndex) && Tokens[TokenIndex].IsPunctuation(Char, SourceText);
+		};
+		const auto SkipComments = [&](int32 TokenIndex)
+		{
+			while (Tokens.IsValidIndex(TokenIndex) && Tokens[TokenIndex].Type == EHLSLTokenType::Comment)
+			{
+				TokenIndex++;
+			}
+			return TokenIndex;
+		};
+		// Returns the index of the token closing the scope opened at TokenIndex, or INDEX_NONE
+		const auto FindClosing = [&](int32 TokenIndex, const TCHAR Open, const TCHAR Close)
+		{
+			int32 Depth = 0;
+			for (; TokenIndex < Tokens.Num(); TokenIndex++)
+			{
+				if (Tokens[TokenIndex].IsPunctuation(Open, SourceText))
+				{
+					Depth++;
+				}
+				else if (Tokens[TokenIndex].IsPunctuation(Close, SourceText) && --Depth == 0)
+				{
+					return TokenIndex;
+				}
+			}
+			return int32(INDEX_NONE);
+		};
+		const auto MakeSpan = [&](const int32 Start, const int32 End)
+		{
+			return FHLSLSpan(Source, Start, End - Start);
+		};
+		const auto GetTokensSpan = [&](const int32 FirstToken, const int32 LastToken)
+		{
+			return MakeSpan(Tokens[FirstToken].Start, Tokens[LastToken].End());
+		};
+
+		// Comment & metadata lines directly above the next function
+		// Cleared when there's an empty line
+		FString PendingComment;
+		FString PendingMetadata;
+		int32 PendingEndLine = 0;
+		// Start of the first pending comment or metadata, INDEX_NONE if nothing is pending
+		int32 PendingStart = INDEX_NONE;
+
+		const auto AddDeclaration = [&](const int32 FirstToken, const int32 LastToken, const bool bIsFunction)
+		{
+			FHLSLParsedDeclaration& Declaration = OutResult.Declarations.Emplace_GetRef();
+			Declaration.Start = PendingStart != INDEX_NONE ? PendingStart : Tokens[FirstToken].Start;
+			Declaration.End = Tokens[LastToken].End();
+			Declaration.bIsFunction = bIsFunction;
+			Declaration.Index = bIsFunction ? OutResult.Functions.Num() - 1 : OutResult.Structs.Num() - 1;
+			PendingStart = INDEX_NONE;
+		};
+
+		int32 Index = 0;
+		while (Index < Tokens.Num())
+		{
+			const FHLSLToken& Token = Tokens[Index];
+
+			if (Token.Line > PendingEndLine + 1)
+			{
+				PendingComment.Reset();
+				PendingMetadata.Reset();
+				PendingStart = INDEX_NONE;
+			}
+
+			// #include/#define/#pragma are handled separately
+			if (Token.Type == EHLSLTokenType::Preprocessor)
+			{
+				PendingEndLine = Token.EndLine;
+				Index++;
+				continue;
+			}
+
+			if (Token.Type == EHLSLTokenType::Comment)
+			{
+				if (PendingStart == INDEX_NONE)
+				{
+					PendingStart = Token.Start;
+				}
+				PendingComment.Append(*SourceText + Token.Start, Token.Length);
+				PendingComment += TEXT("\n");
+				PendingEndLine = Token.EndLine;
+				Index++;
+				continue;
+			}
+
+			if (Token.IsPunctuation(TEXT('['), SourceText))
+			{
+				const int32 MetadataEnd = FindClosing(Index, TEXT('['), TEXT(']'));
+				if (MetadataEnd == INDEX_NONE)
+				{
+					return FString::Printf(TEXT("Unterminated metadata at line %d, column %d"), Token.Line, Token.Column);
+				}
+
+				if (PendingStart == INDEX_NONE)
+				{
+					PendingStart = Token.Start;
+				}
+				PendingMetadata.Append(*SourceText + Token.Start, Tokens[MetadataEnd].End() - Token.Start);
+				PendingMetadata += TEXT("\n");
+				PendingEndLine = Tokens[MetadataEnd].EndLine;
+				Index = MetadataEnd + 1;
+				continue;
+			}
+
+			if (Token.IsIdentifier(TEXT("struct"), SourceText))
+			{
+				PendingComment.Reset();
+				PendingMetadata.Reset();
+
+				const int32 StructStart = Index;
+
+				int32 NameStart = INDEX_NONE;
+				int32 NameEnd = INDEX_NONE;
+				for (Index++; Index < Tokens.Num(); Index++)
+				{
+					if (Tokens[Index].Type == EHLSLTokenType::Comment)
+					{
+						continue;
+					}
+					if (Tokens[Index].IsPunctuation(TEXT('{'), SourceText) ||
+						Tokens[Index].IsPunctuation(TEXT(';'), SourceText))
+					{
+						break;
+					}
+					if (NameStart == INDEX_NONE)
+					{
+						NameStart = Index;
+					}
+					NameEnd = Index;
+				}
+
+				// Forward declaration
+				if (IsPunctuation(Index, TEXT(';')))
+				{
+					PendingStart = INDEX_NONE;
+					Index++;
+					continue;
+				}
+
+				const int32 BodyEnd = Index < Tokens.Num() ? FindClosing(Index, TEXT('{'), TEXT('}')) : INDEX_NONE;
+				if (BodyEnd == INDEX_NONE)
+				{
+					return "Parsing error";
+				}
+
+				// We exit when we encounter the ;
+				int32 StructEnd = BodyEnd + 1;
+				while (StructEnd < Tokens.Num() && !Tokens[StructEnd].IsPunctuation(TEXT(';'), SourceText))
+				{
+					StructEnd++;
+				}
+				if (StructEnd == Tokens.Num())
+				{
+					return "Parsing error";
+				}
+
+				FHLSLParsedStruct& Struct = OutResult.Structs.Emplace_GetRef();
+				if (NameStart != INDEX_NONE)
+				{
+					Struct.Name = GetTokensSpan(NameStart, NameEnd);
+				}
+				Struct.Body = MakeSpan(Tokens[Index].End(), Tokens[BodyEnd].Start);
+				Struct.Text = GetTokensSpan(StructStart, StructEnd);
+				AddDeclaration(StructStart, StructEnd, false);
+
+				Index = StructEnd + 1;
+				continue;
+			}
+
+			// Function or global declaration: find whichever comes first
+			const int32 DeclarationStart = Index;
+			while (Index < Tokens.Num() &&
+				!Tokens[Index].IsPunctuation(TEXT('('), SourceText) &&
+				!Tokens[Index].IsPunctuation(TEXT('{'), SourceText) &&
+				!Tokens[Index].IsPunctuation(TEXT('='), SourceText) &&
+				!Tokens[Index].IsPunctuation(TEXT(';'), SourceText))
+			{
+				Index++;
+			}
+			if (Index == Tokens.Num())
+			{
+				return "Parsing error";
+			}
+
+			if (!Tokens[Index].IsPunctuation(TEXT('('), SourceText))
+			{
+				// Not a function (global variable, cbuffer...): skip till the end of the declaration
+				PendingComment.Reset();
+				PendingMetadata.Reset();
+				PendingStart = INDEX_NONE;
+
+				int32 Depth = 0;
+				for (; Index < Tokens.Num(); Index++)
+				{
+					const FHLSLToken& DeclarationToken = Tokens[Index];
+					if (DeclarationToken.IsPunctuation(TEXT('('), SourceText) || DeclarationToken.IsPunctuation(TEXT('{'), SourceText))
+					{
+						Depth++;
+					}
+					else if (DeclarationToken.IsPunctuation(TEXT(')'), SourceText) || DeclarationToken.IsPunctuation(TEXT('}'), SourceText))
+					{
+						Depth--;
+						// cbuffer Name { ... } don't need a ;
+						if (Depth == 0 && DeclarationToken.IsPunctuation(TEXT('}'), SourceText) && !IsPunctuation(SkipComments(Index + 1), TEXT(';')))
+						{
+							break;
+						}
+					}
+					else if (Depth == 0 && DeclarationToken.IsPunctuation(TEXT(';'), SourceText))
+					{
+						break;
+					}
+				}
+				if (Index == Tokens.Num())
+				{
+					return "Parsing error";
+				}
+				Index++;
+				continue;
+			}
+
+			const int32 ArgsStart = Index;
+			const int32 NameIndex = Index - 1;
+			if (NameIndex <= DeclarationStart ||
+				Tokens[NameIndex].Type != EHLSLTokenType::Identifier)
+			{
+				return FString::Printf(TEXT("Invalid function declaration at line %d, column %d"), Token.Line, Token.Column);
+			}
+
+			FHLSLParsedFunction& Function = OutResult.Functions.Emplace_GetRef();
+			OutResult.PreviousFunctionIndices.Add(INDEX_NONE);
+			Function.Comment = MoveTemp(PendingComment);
+			Function.Metadata = MoveTemp(PendingMetadata);
+			Function.ReturnType = GetTokensSpan(DeclarationStart, NameIndex - 1);
+			Function.Name = GetTokensSpan(NameIndex, NameIndex);
+			PendingComment.Reset();
+			PendingMetadata.Reset();
+
+			const int32 ArgsEnd = FindClosing(ArgsStart, TEXT('('), TEXT(')'));
+			if (ArgsEnd == INDEX_NONE)
+			{
+				return "Parsing error";
+			}
+
+			// Split the arguments on the top-level commas, keeping the text as written
+			{
+				int32 ArgParenthesisScopeDepth = 0;
+				int32 ArgBracketScopeDepth = 0;
+				int32 ArgStart = Tokens[ArgsStart].End();
+				for (int32 ArgIndex = ArgsStart + 1; ArgIndex <= ArgsEnd; ArgIndex++)
+				{
+					const FHLSLToken& ArgToken = Tokens[ArgIndex];
+					if (ArgToken.Type != EHLSLTokenType::Punctuation)
+					{
+						continue;
+					}
+
+					const TCHAR Char = SourceText[ArgToken.Start];
+					if (Char == TEXT('(')) ArgParenthesisScopeDepth++;
+					if (Char == TEXT(')')) ArgParenthesisScopeDepth--;
+					if (Char == TEXT('[')) ArgBracketScopeDepth++;
+					if (Char == TEXT(']')) ArgBracketScopeDepth--;
+
+					if ((Char == TEXT(',') && ArgParenthesisScopeDepth == 0 && ArgBracketScopeDepth == 0) ||
+						ArgIndex == ArgsEnd)
+					{
+						if (ArgToken.Start > ArgStart || Char == TEXT(','))
+						{
+							Function.Arguments.Add(MakeSpan(ArgStart, ArgToken.Start));
+						}
+						ArgStart = ArgToken.End();
+					}
+				}
+			}
+
+			// Allow comments between the function args and the body
+			const int32 BodyStart = SkipComments(ArgsEnd + 1);
+			if (!IsPunctuation(BodyStart, TEXT('{')))
+			{
+				return FString::Printf(TEXT("Invalid function body for %s: missing {"), *Function.Name.ToString());
+			}
+
+			const int32 BodyEnd = FindClosing(BodyStart, TEXT('{'), TEXT('}'));
+			if (BodyEnd == INDEX_NONE)
+			{
+				return "Parsing error";
+			}
+
+			if (Options.bAccurateErrors)
+			{
+				Function.StartLine = Tokens[BodyStart].Line - 1;
+			}
+			Function.Body = MakeSpan(Tokens[BodyStart].End(), Tokens[BodyEnd].Start);
+			AddDeclaration(DeclarationStart, BodyEnd, true);
+
+			Index = BodyEnd + 1;
+		}
+
+		if (PendingStart != INDEX_NONE)
+		{
+			OutPendingEndLine = PendingEndLine;
+		}
+
+		return {};
+	}
+
+	int32 CountLines(const FString& Text, const int32 Start, const int32 End)
+	{
+		int32 NumLines = 0;
+		for (int32 Index = Start; Index < End; Index++)
+		{
+			NumLines += Text[Index] == TEXT('\n');
+		}
+		return NumLines;
+	}
+
+	// Copy a declaration of a previous result that wasn't edited, shifting it by Offset characters & LineOffset lines
+	void CopyDeclaration(
+		const FHLSLParseResult& Previous,
+		const int32 DeclarationIndex,
+		const TSharedRef<const FString>& Source,
+		const int32 Offset,
+		const int32 LineOffset,
+		FHLSLParseResult& OutResult)
+	{
+		const FHLSLParsedDeclaration& PreviousDeclaration = Previous.Declarations[DeclarationIndex];
+
+		FHLSLParsedDeclaration& Declaration = OutResult.Declarations.Add_GetRef(PreviousDeclaration);
+		Declaration.Start += Offset;
+		Declaration.End += Offset;
+
+		if (PreviousDeclaration.bIsFunction)
+		{
+			const FHLSLParsedFunction& PreviousFunction = Previous.Functions[PreviousDeclaration.Index];
+
+			FHLSLParsedFunction Function;
+			Function.StartLine = PreviousFunction.StartLine + (OutResult.Options.bAccurateErrors ? LineOffset : 0);
+			Function.Comment = PreviousFunction.Comment;
+			Function.Metadata = PreviousFunction.Metadata;
+			Function.ReturnType = PreviousFunction.ReturnType.Rebase(Source, Offset);
+			Function.Name = PreviousFunction.Name.Rebase(Source, Offset);
+			Function.Arguments.Reserve(PreviousFunction.Arguments.Num());
+			for (const FHLSLSpan& Argument : PreviousFunction.Arguments)
+			{
+				Function.Arguments.Add(Argument.Rebase(Source, Offset));
+			}
+			Function.Body = PreviousFunction.Body.Rebase(Source, Offset);
+
+			Declaration.Index = OutResult.Functions.Add(MoveTemp(Function));
+			OutResult.PreviousFunctionIndices.Add(PreviousDeclaration.Index);
+		}
+		else
+		{
+			const FHLSLParsedStruct& PreviousStruct = Previous.Structs[PreviousDeclaration.Index];
+
+			FHLSLParsedStruct Struct;
+			Struct.Name = PreviousStruct.Name.Rebase(Source, Offset);
+			Struct.Body = PreviousStruct.Body.Rebase(Source, Offset);
+			Struct.Text = PreviousStruct.Text.Rebase(Source, Offset);
+
+			Declaration.Index = OutResult.Structs.Add(MoveTemp(Struct));
+		}
+	}
+
+	// Only reparse the declarations overlapping the edited region, ie between the common prefix & suffix of the two texts
+	// Returns false if the edit can't be isolated, in which case the whole text must be parsed
+	bool TryParseIncremental(const FHLSLParseResult& Previous, const TSharedRef<const FString>& Source, FHLSLParseResult& OutResult)
+	{
+		const FString& OldText = *Previous.Source;
+		const FString& NewText = *Source;
+		const int32 MinLen = FMath::Min(OldText.Len(), NewText.Len());
+
+		int32 PrefixLen = 0;
+		while (PrefixLen < MinLen && OldText[PrefixLen] == NewText[PrefixLen])
+		{
+			PrefixLen++;
+		}
+		int32 SuffixLen = 0;
+		while (SuffixLen < MinLen - PrefixLen && OldText[OldText.Len() - 1 - SuffixLen] == NewText[NewText.Len() - 1 - SuffixLen])
+		{
+			SuffixLen++;
+		}
+		const int32 Offset = NewText.Len() - OldText.Len();
+
+		// Declarations entirely before the edit, followed by nothing but whitespace on their last line
+		// so that the range can start on a fresh line with nothing pending
+		int32 NumPrefixDeclarations = 0;
+		int32 RangeStart = 0;
+		for (const FHLSLParsedDeclaration& Declaration : Previous.Declarations)
+		{
+			int32 LineEnd = Declaration.End;
+			while (LineEnd < PrefixLen && OldText[LineEnd] != TEXT('\n') && FChar::IsWhitespace(OldText[LineEnd]))
+			{
+				LineEnd++;
+			}
+			if (LineEnd >= PrefixLen || OldText[LineEnd] != TEXT('\n'))
+			{
+				break;
+			}
+
+			NumPrefixDeclarations++;
+			RangeStart = LineEnd + 1;
+		}
+
+		// Declarations entirely after the edit, starting on their own line
+		int32 FirstSuffixDeclaration = Previous.Declarations.Num();
+		int32 OldRangeEnd = OldText.Len();
+		for (int32 Index = Previous.Declarations.Num() - 1; Index >= NumPrefixDeclarations; Index--)
+		{
+			const int32 Start = Previous.Declarations[Index].Start;
+			if (Start - 1 < OldText.Len() - SuffixLen ||
+				OldText[Start - 1] != TEXT('\n'))
+			{
+				break;
+			}
+
+			FirstSuffixDeclaration = Index;
+			OldRangeEnd = Start;
+		}
+		const int32 NewRangeEnd = OldRangeEnd + Offset;
+		check(RangeStart <= NewRangeEnd);
+
+		// A \ at the end of the range would continue a preprocessor directive into the next declaration
+		if (NewRangeEnd >= 2 &&
+			NewRangeEnd < NewText.Len() &&
+			NewText[NewRangeEnd - 2] == TEXT('\\'))
+		{
+			return false;
+		}
+
+		const int32 FirstLine = 1 + CountLines(NewText, 0, RangeStart);
+		const int32 NumNewLines = CountLines(NewText, RangeStart, NewRangeEnd);
+		const int32 LineOffset = NumNewLines - CountLines(OldText, RangeStart, OldRangeEnd);
+
+		for (int32 Index = 0; Index < NumPrefixDeclarations; Index++)
+		{
+			CopyDeclaration(Previous, Index, Source, 0, 0, OutResult);
+		}
+
+		int32 PendingEndLine = INDEX_NONE;
+		if (!ParseDeclarations(OutResult.Options, Source, RangeStart, NewRangeEnd, FirstLine, OutResult, PendingEndLine).IsEmpty())
+		{
+			return false;
+		}
+
+		// Comments left at the end of the range that would have been attached to the next declaration
+		if (PendingEndLine != INDEX_NONE &&
+			FirstSuffixDeclaration < Previous.Declarations.Num() &&
+			PendingEndLine + 1 >= FirstLine + NumNewLines)
+		{
+			return false;
+		}
+
+		for (int32 Index = FirstSuffixDeclaration; Index < Previous.Declarations.Num(); Index++)
+		{
+			CopyDeclaration(Previous, Index, Source, Offset, LineOffset, OutResult);
+		}
+
+		return true;
+	}
+}
+
+FString FHLSLParser::Parse(
+	const FHLSLParseOptions& Options,
+	FString Text,
+	TArray<FHLSLParsedFunction>& OutFunctions,
+	TArray<FHLSLParsedStruct>& OutStructs)
+{
+	FHLSLParseResult Result;
+	const FString Error = Parse(Options, MoveTemp(Text), Result);
+	if (!Error.IsEmpty())
+	{
+		return Error;
+	}
+
+	OutFunctions.Append(MoveTemp(Result.Functions));
+	OutStructs.Append(MoveTemp(Result.Structs));
+	return {};
+}
+
+FString FHLSLParser::Parse(
+	const FHLSLParseOptions& Options,
+	FString Text,
+	FHLSLParseResult& OutResult,
+	const FHLSLParseResult* Previous)
+{
+	// Simplify line breaks handling
+	Text.ReplaceInline(TEXT("\r\n"), TEXT("\n"));
+
+	// All the results point into this
+	const TSharedRef<const FString> Source = MakeShared<const FString>(MoveTemp(Text));
+
+	OutResult = {};
+	OutResult.Options = Options;
+	OutResult.Source = Source;
+
+	if (Previous &&
+		Previous->Source &&
+		Previous->Options.bAccurateErrors == Options.bAccurateErrors)
+	{
+		if (TryParseIncremental(*Previous, Source, OutResult))
+		{
+			return {};
+		}
+
+		OutResult.Functions.Reset();
+		OutResult.Structs.Reset();
+		OutResult.Declarations.Reset();
+		OutResult.PreviousFunctionIndices.Reset();
+	}
+
+	int32 PendingEndLine;
+	return ParseDeclarations(Options, Source, 0, Source->Len(), 1, OutResult, PendingEndLine);
+}
+
+namespace
+{
+	// Recursive descent over the tokens of a struct body or of a single argument
+	// Every token is visited once, so this stays linear even on malformed input
+	class FHLSLDeclaratorParser
+	{
+	public:
+		explicit FHLSLDeclaratorParser(const FHLSLSpan& Span)
+			: Span(Span)
+			, Text(Span.GetView())
+		{
+		}
+
+		FString Tokenize()
+		{
+			TArray<FHLSLToken> AllTokens;
+			const FString Error = FHLSLLexer::Tokenize(Text, AllTokens);
+			if (!Error.IsEmpty())
+			{
+				return Error;
+			}
+
+			// Comments are not part of the declarations
+			Tokens.Reserve(AllTokens.Num());
+			for (const FHLSLToken& Token : AllTokens)
+			{
+				if (Token.Type != EHLSLTokenType::Comment &&
+					Token.Type != EHLSLTokenType::Preprocessor)
+				{
+					Tokens.Add(Token);
+				}
+			}
+			return {};
+		}
+
+		bool IsAtEnd() const
+		{
+			return Index >= Tokens.Num();
+		}
+		bool SkipEmptyDeclaration()
+		{
+			if (!Peek(TEXT(';')))
+			{
+				return false;
+			}
+			Index++;
+			return true;
+		}
+
+		FString ParseDeclarator(FHLSLParsedDeclarator& OutDeclarator, const bool bStructMember)
+		{
+			while (Peek(TEXT('[')))
+			{
+				const int32 MetadataEnd = FindClosing(TEXT('['), TEXT(']'));
+				if (MetadataEnd == INDEX_NONE)
+				{
+					return MakeError(Index, TEXT("Unterminated metadata"));
+				}
+
+				if (!OutDeclarator.Metadata.IsEmpty())
+				{
+					OutDeclarator.Metadata += TEXT(",");
+				}
+				OutDeclarator.Metadata += GetTextBetween(Index, MetadataEnd);
+				Index = MetadataEnd + 1;
+			}
+
+			for (; PeekIdentifier(); Index++)
+			{
+				const FStringView Modifier = GetText(Index);
+				if (Modifier.Equals(TEXT("const"), ESearchCase::CaseSensitive))
+				{
+					OutDeclarator.bIsConst = true;
+				}
+				else if (
+					Modifier.Equals(TEXT("out"), ESearchCase::CaseSensitive) ||
+					Modifier.Equals(TEXT("inout"), ESearchCase::CaseSensitive))
+				{
+					OutDeclarator.bIsOutput = true;
+				}
+				else if (
+					!Modifier.Equals(TEXT("in"), ESearchCase::CaseSensitive) &&
+					!Modifier.Equals(TEXT("uniform"), ESearchCase::CaseSensitive))
+				{
+					break;
+				}
+			}
+
+			if (!PeekIdentifier())
+			{
+				return MakeError(Index, TEXT("Expected a type"));
+			}
+			OutDeclarator.Type = FString(GetText(Index++));
+
+			if (Peek(TEXT('<')))
+			{
+				const int32 TemplateEnd = FindClosing(TEXT('<'), TEXT('>'));
+				if (TemplateEnd == INDEX_NONE)
+				{
+					return MakeError(Index, TEXT("Unterminated template arguments"));
+				}
+				OutDeclarator.TemplateArguments = GetTextBetween(Index, TemplateEnd);
+				Index = TemplateEnd + 1;
+			}
+
+			if (!PeekIdentifier())
+			{
+				return MakeError(Index, *FString::Printf(TEXT("Expected a name after %s"), *OutDeclarator.Type));
+			}
+			OutDeclarator.Name = FString(GetText(Index++));
+
+			if (Peek(TEXT('[')))
+			{
+				const int32 ArrayEnd = FindClosing(TEXT('['), TEXT(']'));
+				if (ArrayEnd == INDEX_NONE)
+				{
+					return MakeError(Index, TEXT("Unterminated array size"));
+				}
+				OutDeclarator.ArraySize = GetTextBetween(Index, ArrayEnd);
+				Index = ArrayEnd + 1;
+			}
+
+			if (Peek(TEXT(':')))
+			{
+				Index++;
+				if (!PeekIdentifier())
+				{
+					return MakeError(Index, TEXT("Expected a semantic"));
+				}
+				OutDeclarator.Semantic = FString(GetText(Index++));
+			}
+
+			if (Peek(TEXT('=')))
+			{
+				Index++;
+
+				const int32 ValueStart = Index;
+				int32 Depth = 0;
+				for (; !IsAtEnd(); Index++)
+				{
+					if (Peek(TEXT('(')) || Peek(TEXT('{')) || Peek(TEXT('[')))
+					{
+						Depth++;
+					}
+					else if (Peek(TEXT(')')) || Peek(TEXT('}')) || Peek(TEXT(']')))
+					{
+						Depth--;
+					}
+					else if (bStructMember && Depth == 0 && Peek(TEXT(';')))
+					{
+						break;
+					}
+				}
+
+				if (Index == ValueStart)
+				{
+					return MakeError(Index, TEXT("Expected a default value"));
+				}
+				OutDeclarator.DefaultValue = FString(Text.Mid(Tokens[ValueStart].Start, Tokens[Index - 1].End() - Tokens[ValueStart].Start));
+			}
+
+			if (bStructMember)
+			{
+				if (!Peek(TEXT(';')))
+				{
+					return MakeError(Index, TEXT("Expected ;"));
+				}
+				Index++;
+			}
+			else if (!IsAtEnd())
+			{
+				return MakeError(Index, TEXT("Unexpected token"));
+			}
+
+			return {};
+		}
+
+	private:
+		const FHLSLSpan& Span;
+		const FStringView Text;
+		TArray<FHLSLToken> Tokens;
+		int32 Index = 0;
+
+		bool Peek(const TCHAR Char) const
+		{
+			return !IsAtEnd() && Tokens[Index].IsPunctuation(Char, Text);
+		}
+		bool PeekIdentifier() const
+		{
+			return !IsAtEnd() && Tokens[Index].Type == EHLSLTokenType::Identifier;
+		}
+		FStringView GetText(const int32 TokenIndex) const
+		{
+			return Tokens[TokenIndex].GetText(Text);
+		}
+		// Text strictly between two tokens, trimmed
+		FString GetTextBetween(const int32 FirstToken, const int32 LastToken) const
+		{
+			const int32 Start = Tokens[FirstToken].End();
+			return FString(Text.Mid(Start, Tokens[LastToken].Start - Start)).TrimStartAndEnd();
+		}
+		// Returns the index of the token closing the scope opened at Index, or INDEX_NONE
+		int32 FindClosing(const TCHAR Open, const TCHAR Close) const
+		{
+			int32 Depth = 0;
+			for (int32 TokenIndex = Index; TokenIndex < Tokens.Num(); TokenIndex++)
+			{
+				if (Tokens[TokenIndex].IsPunctuation(Open, Text))
+				{
+					Depth++;
+				}
+				else if (Tokens[TokenIndex].IsPunctuation(Close, Text) && --Depth == 0)
+				{
+					return TokenIndex;
+				}
+			}
+			return INDEX_NONE;
+		}
+
+		FString MakeError(const int32 TokenIndex, const TCHAR* Message) const
+		{
+			int32 SpanLine;
+			int32 SpanColumn;
+			Span.GetLocation(SpanLine, SpanColumn);
+
+			// Point right after the last token if we reached the end
+			int32 Line = 1;
+			int32 Column = 1;
+			FString Found = TEXT("end of declaration");
+			if (Tokens.IsValidIndex(TokenIndex))
+			{
+				Line = Tokens[TokenIndex].Line;
+				Column = Tokens[TokenIndex].Column;
+				Found = TEXT("'") + FString(GetText(TokenIndex)) + TEXT("'");
+			}
+			else if (Tokens.Num() > 0)
+			{
+				Line = Tokens.Last().EndLine;
+				Column = Tokens.Last().Column + Tokens.Last().Length;
+			}
+
+			if (Line == 1)
+			{
+				Column += SpanColumn - 1;
+			}
+			Line += SpanLine - 1;
+
+			return FString::Printf(TEXT("%s at line %d, column %d, found %s"), Message, Line, Column, *Found);
+		}
+	};
+}
+
+FString FHLSLParser::ParseStructMembers(const FHLSLSpan& Body, TArray<FHLSLParsedDeclarator>& OutMembers)
+{
+	FHLSLDeclaratorParser Parser(Body);
+	{
+		const FString Error = Parser.Tokenize();
+		if (!Error.IsEmpty())
+		{
+			return Error;
+		}
+	}
+
+	while (!Parser.IsAtEnd())
+	{
+		if (Parser.SkipEmptyDeclaration())
+		{
+			continue;
+		}
+
+		const FString Error = Parser.ParseDeclarator(OutMembers.Emplace_GetRef(), true);
+		if (!Error.IsEmpty())
+		{
+			return Error;
+		}
+	}
+
+	return {};
+}
+
+FString FHLSLParser::ParseArgument(const FHLSLSpan& Argument, FHLSLParsedDeclarator& OutArgument)
+{
+	FHLSLDeclaratorParser Parser(Argument);
+	{
+		const FString Error = Parser.Tokenize();
+		if (!Error.IsEmpty())
+		{
+			return Error;
+		}
+	}
+
+	return Parser.ParseDeclarator(OutArgument, false);
+}
+
+namespace
+{
+	class FHLSLLiteralParser
+	{
+	public:
+		static constexpr int32 MaxComponents = 4;
+		// float(float(...)) is valid but pointless past that, and would otherwise overflow the stack on malformed input
+		static constexpr int32 MaxDepth = 8;
+
+		double Components[MaxComponents] = {};
+		int32 NumComponents = 0;
+
+		explicit FHLSLLiteralParser(const FStringView Text)
+			: Text(Text)
+		{
+		}
+
+		bool Parse()
+		{
+			if (!ParseValue())
+			{
+				return false;
+			}
+			SkipWhitespace();
+			return Index == Text.Len();
+		}
+
+	private:
+		const FStringView Text;
+		int32 Index = 0;
+		int32 Depth = 0;
+
+		TCHAR PeekChar(const int32 Offset = 0) const
+		{
+			return Index + Offset < Text.Len() ? Text[Index + Offset] : TEXT('\0');
+		}
+		void SkipWhitespace()
+		{
+			while (Index < Text.Len() && FChar::IsWhitespace(Text[Index]))
+			{
+				Index++;
+			}
+		}
+		bool Consume(const TCHAR Char)
+		{
+			SkipWhitespace();
+			if (PeekChar() != Char)
+			{
+				return false;
+			}
+			Index++;
+			return true;
+		}
+		bool AddComponent(const double Value)
+		{
+			if (NumComponents == MaxComponents)
+			{
+				return false;
+			}
+			Components[NumComponents++] = Value;
+			return true;
+		}
+
+		// Either a scalar or a constructor, which can contain other constructors
+		bool ParseValue()
+		{
+			SkipWhitespace();
+
+			if (!FChar::IsAlpha(PeekChar()))
+			{
+				double Value;
+				return ParseScalar(Value) && AddComponent(Value);
+			}
+
+			const int32 NameStart = Index;
+			while (FChar::IsAlpha(PeekChar()))
+			{
+				Index++;
+			}
+			const FStringView BaseType = Text.Mid(NameStart, Index - NameStart);
+			if (!BaseType.Equals(TEXT("float"), ESearchCase::CaseSensitive) &&
+				!BaseType.Equals(TEXT("half"), ESearchCase::CaseSensitive) &&
+				!BaseType.Equals(TEXT("double"), ESearchCase::CaseSensitive) &&
+				!BaseType.Equals(TEXT("int"), ESearchCase::CaseSensitive) &&
+				!BaseType.Equals(TEXT("uint"), ESearchCase::CaseSensitive))
+			{
+				return false;
+			}
+
+			int32 Dimension = 1;
+			if (PeekChar() >= TEXT('1') && PeekChar() <= TEXT('4'))
+			{
+				Dimension = PeekChar() - TEXT('0');
+				Index++;
+			}
+
+			if (!Consume(TEXT('(')) || Depth == MaxDepth)
+			{
+				return false;
+			}
+
+			const int32 FirstComponent = NumComponents;
+			Depth++;
+			do
+			{
+				if (!ParseValue())
+				{
+					return false;
+				}
+			}
+			while (Consume(TEXT(',')));
+			Depth--;
+
+			if (!Consume(TEXT(')')))
+			{
+				return false;
+			}
+
+			// float3(1) is float3(1, 1, 1)
+			if (NumComponents - FirstComponent == 1)
+			{
+				while (NumComponents - FirstComponent < Dimension)
+				{
+					if (!AddComponent(Components[FirstComponent]))
+					{
+						return false;
+					}
+				}
+			}
+
+			return NumComponents - FirstComponent == Dimension;
+		}
+
+		bool ParseScalar(double& OutValue)
+		{
+			bool bNegative = false;
+			for (SkipWhitespace(); PeekChar() == TEXT('-') || PeekChar() == TEXT('+'); SkipWhitespace())
+			{
+				bNegative ^= PeekChar() == TEXT('-');
+				Index++;
+			}
+
+			if (PeekChar() == TEXT('0') && (PeekChar(1) == TEXT('x') || PeekChar(1) == TEXT('X')))
+			{
+				Index += 2;
+
+				const int32 DigitsStart = Index;
+				uint64 Value = 0;
+				while (FChar::IsHexDigit(PeekChar()))
+				{
+					Value = Value * 16 + FParse::HexDigit(PeekChar());
+					Index++;
+				}
+				if (Index == DigitsStart)
+				{
+					return false;
+				}
+
+				SkipIntegerSuffix();
+				OutValue = bNegative ? -double(Value) : double(Value);
+				return true;
+			}
+
+			const int32 NumberStart = Index;
+			int32 NumDigits = 0;
+			while (FChar::IsDigit(PeekChar()))
+			{
+				Index++;
+				NumDigits++;
+			}
+			if (PeekChar() == TEXT('.'))
+			{
+				Index++;
+				while (FChar::IsDigit(PeekChar()))
+				{
+					Index++;
+					NumDigits++;
+				}
+			}
+			if (NumDigits == 0)
+			{
+				return false;
+			}
+			if (PeekChar() == TEXT('e') || PeekChar() == TEXT('E'))
+			{
+				const int32 ExponentStart = Index;
+				Index++;
+				if (PeekChar() == TEXT('-') || PeekChar() == TEXT('+'))
+				{
+					Index++;
+				}
+				if (!FChar::IsDigit(PeekChar()))
+				{
+					// Not an exponent after all
+					Index = ExponentStart;
+				}
+				while (FChar::IsDigit(PeekChar()))
+				{
+					Index++;
+				}
+			}
+			const int32 NumberEnd = Index;
+
+			const TCHAR Suffix = PeekChar();
+			if (Suffix == TEXT('f') || Suffix == TEXT('F') || Suffix == TEXT('h') || Suffix == TEXT('H'))
+			{
+				Index++;
+			}
+			else
+			{
+				SkipIntegerSuffix();
+			}
+
+			// Copy to a null-terminated buffer on the stack for Atod
+			TCHAR Buffer[64];
+			const int32 Length = NumberEnd - NumberStart;
+			if (Length >= UE_ARRAY_COUNT(Buffer))
+			{
+				return false;
+			}
+			FMemory::Memcpy(Buffer, Text.GetData() + NumberStart, Length * sizeof(TCHAR));
+			Buffer[Length] = TEXT('\0');
+
+			const double Value = FCString::Atod(Buffer);
+			OutValue = bNegative ? -Value : Value;
+			return true;
+		}
+		void SkipIntegerSuffix()
+		{
+			while (PeekChar() == TEXT('u') || PeekChar() == TEXT('U') || PeekChar() == TEXT('l') || PeekChar() == TEXT('L'))
+			{
+				Index++;
+			}
+		}
+	};
+}
+
+bool FHLSLParser::ParseVectorLiteral(const FStringView Literal, const int32 Dimension, FVector4& OutValue)
+{
+	check(1 <= Dimension && Dimension <= 4);
+
+	FHLSLLiteralParser Parser(Literal);
+	if (!Parser.Parse())
+	{
+		return false;
+	}
+
+	if (Parser.NumComponents == 1)
+	{
+		// Like HLSL, float3 Value = 2 is float3(2, 2, 2)
+		const double Value = Parser.Components[0];
+		for (int32 Index = 0; Index < Dimension; Index++)
+		{
+			OutValue[Index] = Value;
+		}
+		return true;
+	}
+
+	if (Parser.NumComponents != Dimension)
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < Dimension; Index++)
+	{
+		OutValue[Index] = Parser.Components[Index];
+	}
+	return true;
+}
+
+FHLSLParsedDirectives FHLSLParser::GetDirectives(const FString& Text)
+{
+	FHLSLParsedDirectives Directives;
+
+	const TCHAR* const Chars = *Text;
+	const int32 Num = Text.Len();
+
+	int32 Index = 0;
+	int32 Line = 1;
+	bool bInBlockComment = false;
+
+	const auto IsBlank = [](const TCHAR Char)
+	{
+		return Char == TEXT(' ') || Char == TEXT('\t');
+	};
+	const auto IsWordChar = [](const TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_');
+	};
+	const auto IsLineEnd = [&](const int32 InIndex)
+	{
+		return InIndex >= Num || Chars[InIndex] == TEXT('\n') || Chars[InIndex] == TEXT('\r');
+	};
+
+	// One iteration per line
+	while (Index < Num)
+	{
+		if (!bInBlockComment)
+		{
+			while (Index < Num && IsBlank(Chars[Index]))
+			{
+				Index++;
+			}
+
+			if (Index < Num && Chars[Index] == TEXT('#'))
+			{
+				const int32 DirectiveLine = Line;
+
+				Index++;
+				while (Index < Num && IsBlank(Chars[Index]))
+				{
+					Index++;
+				}
+
+				const int32 KeywordStart = Index;
+				while (Index < Num && IsWordChar(Chars[Index]))
+				{
+					Index++;
+				}
+				const FStringView Keyword(Chars + KeywordStart, Index - KeywordStart);
+
+				// Arguments are only read from the first line
+				const int32 ArgsStart = Index;
+				while (!IsLineEnd(Index))
+				{
+					Index++;
+				}
+				FStringView Args(Chars + ArgsStart, Index - ArgsStart);
+
+				// Skip \ continuations
+				while (Index < Num && Index > 0 && Chars[Index - 1] == TEXT('\\'))
+				{
+					if (Chars[Index] == TEXT('\r') && Index + 1 < Num && Chars[Index + 1] == TEXT('\n'))
+					{
+						Index++;
+					}
+					Index++;
+					Line++;
+
+					while (!IsLineEnd(Index))
+					{
+						Index++;
+					}
+				}
+
+				const auto ReadWord = [&]
+				{
+					int32 WordLength = 0;
+					while (WordLength < Args.Len() && IsWordChar(Args[WordLength]))
+					{
+						WordLength++;
+					}
+					const FStringView Word = Args.Left(WordLength);
+					Args.RightChopInline(WordLength);
+					return Word;
+				};
+				const auto SkipBlanks = [&]
+				{
+					int32 NumBlanks = 0;
+					while (NumBlanks < Args.Len() && IsBlank(Args[NumBlanks]))
+					{
+						NumBlanks++;
+					}
+					Args.RightChopInline(NumBlanks);
+					return NumBlanks > 0;
+				};
+
+				if (Keyword.Equals(TEXT("include"), ESearchCase::CaseSensitive))
+				{
+					// Only "..." includes, <...> are engine ones
+					SkipBlanks();
+					if (Args.StartsWith(TEXT('"')))
+					{
+						const FStringView Path = Args.RightChop(1);
+						int32 PathEnd;
+						if (Path.FindChar(TEXT('"'), PathEnd))
+						{
+							Directives.Includes.Add({ FString(Path.Left(PathEnd)), DirectiveLine });
+						}
+					}
+				}
+				else if (Keyword.Equals(TEXT("define"), ESearchCase::CaseSensitive))
+				{
+					// Function-like macros and defines without value are skipped
+					if (SkipBlanks())
+					{
+						const FStringView Name = ReadWord();
+						if (SkipBlanks())
+						{
+							Directives.Defines.Add({ FString(Name), FString(Args).TrimEnd(), DirectiveLine });
+						}
+					}
+				}
+				else if (Keyword.Equals(TEXT("pragma"), ESearchCase::CaseSensitive))
+				{
+					// #pragma once etc are skipped
+					if (SkipBlanks())
+					{
+						const FStringView Type = ReadWord();
+						if (SkipBlanks())
+						{
+							const FStringView Name = ReadWord();
+							Directives.Pragmas.Add({ FString(Type), FString(Name), DirectiveLine });
+						}
+					}
+				}
+			}
+		}
+
+		// Skip the rest of the line, keeping track of comments & strings so that we don't misdetect a block comment
+		while (!IsLineEnd(Index))
+		{
+			const TCHAR Char = Chars[Index];
+			const TCHAR NextChar = Index + 1 < Num ? Chars[Index + 1] : TEXT('\0');
+
+			if (bInBlockComment)
+			{
+				if (Char == TEXT('*') && NextChar == TEXT('/'))
+				{
+					bInBlockComment = false;
+					Index++;
+				}
+			}
+			else if (Char == TEXT('/') && NextChar == TEXT('/'))
+			{
+				while (!IsLineEnd(Index))
+				{
+					Index++;
+				}
+				break;
+			}
+			else if (Char == TEXT('/') && NextChar == TEXT('*'))
+			{
+				bInBlockComment = true;
+				Index++;
+			}
+			else if (Char == TEXT('"'))
+			{
+				Index++;
+				while (!IsLineEnd(Index) && Chars[Index] != TEXT('"'))
+				{
+					Index += Chars[Index] == TEXT('\\') ? 2 : 1;
+				}
+				if (IsLineEnd(Index))
+				{
+					break;
+				}
+			}
+			Index++;
+		}
+
+		// Line break, \r\n counted once
+		if (Index < Num && Chars[Index] == TEXT('\r') && Index + 1 < Num && Chars[Index + 1] == TEXT('\n'))
+		{
+			Index++;
+		}
+		Index++;
+		Line++;
+	}
+
+	return Directives;
+}
+
+bool FHLSLParser::ContainsIdentifier(const FStringView Text, const FStringView Identifier)
+{
+	if (Identifier.IsEmpty())
+	{
+		return false;
+	}
+
+	const auto IsWordChar = [](const TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_');
+	};
+
+	int32 SearchStart = 0;
+	while (SearchStart + Identifier.Len() <= Text.Len())
+	{
+		const int32 Found = UE::String::FindFirst(Text.RightChop(SearchStart), Identifier, ESearchCase::CaseSensitive);
+		if (Found == INDEX_NONE)
+		{
+			return false;
+		}
+
+		const int32 Start = SearchStart + Found;
+		const int32 End = Start + Identifier.Len();
+		if ((Start == 0 || !IsWordChar(Text[Start - 1])) &&
+			(End == Text.Len() || !IsWordChar(Text[End])))
+		{
+			return true;
+		}
+
+		SearchStart = Start + 1;
+	}
+	return false;
+}
+
+FString FHLSLParser::CanonicalizeCode(const FStringView Code, const bool bKeepLineCount)
+{
+	FString Result;
+	Result.Reserve(Code.Len());
+
+	const auto LastChar = [&](const int32 Offset)
+	{
+		return Result.Len() >= Offset ? Result[Result.Len() - Offset] : TEXT('\n');
+	};
+	const auto IsWordChar = [](const TCHAR Char)
+	{
+		return FChar::IsAlnum(Char) || Char == TEXT('_');
+	};
+
+	// Spaces are only written before the next char of the same line, so that lines are trimmed
+	bool bPendingSpace = false;
+	// In #define X (Y) the space matters
+	bool bIsDirective = false;
+	// Line breaks inside block comments, added at the end of the line the comment ends on
+	// Writing them in place would end a preprocessor directive the comment is part of
+	int32 PendingLines = 0;
+
+	const auto Append = [&](const TCHAR Char)
+	{
+		const TCHAR PreviousChar = LastChar(1);
+		if (PreviousChar == TEXT('\n'))
+		{
+			// Indentation of a continued directive is still a space once the lines are joined
+			if (bPendingSpace && bIsDirective)
+			{
+				Result += TEXT(' ');
+			}
+			bIsDirective |= Char == TEXT('#');
+		}
+		// Only keep the spaces that separate two identifiers, or two symbols that would merge into another one (a - -b)
+		else if (bPendingSpace && (bIsDirective || IsWordChar(PreviousChar) == IsWordChar(Char)))
+		{
+			Result += TEXT(' ');
+		}
+		bPendingSpace = false;
+		Result += Char;
+	};
+	const auto EndLine = [&]
+	{
+		bPendingSpace = false;
+
+		// A blank line after a line continuation ends the directive: it must stay
+		const bool bIsContinued = LastChar(1) == TEXT('\\');
+		if (bKeepLineCount ||
+			LastChar(1) != TEXT('\n') ||
+			LastChar(2) == TEXT('\\'))
+		{
+			Result += TEXT('\n');
+		}
+		if (!bIsContinued)
+		{
+			bIsDirective = false;
+		}
+
+		if (bKeepLineCount)
+		{
+			for (; PendingLines > 0; PendingLines--)
+			{
+				Result += TEXT('\n');
+			}
+		}
+		PendingLines = 0;
+	};
+
+	int32 Index = 0;
+	while (Index < Code.Len())
+	{
+		const TCHAR Char = Code[Index];
+		const TCHAR NextChar = Index + 1 < Code.Len() ? Code[Index + 1] : TEXT('\0');
+
+		if (Char == TEXT('\n'))
+		{
+			EndLine();
+			Index++;
+		}
+		else if (FChar::IsWhitespace(Char))
+		{
+			bPendingSpace = true;
+			Index++;
+		}
+		else if (Char == TEXT('/') && NextChar == TEXT('/'))
+		{
+			// Up to the line break, which is kept
+			while (Index < Code.Len() && Code[Index] != TEXT('\n'))
+			{
+				Index++;
+			}
+		}
+		else if (Char == TEXT('/') && NextChar == TEXT('*'))
+		{
+			// Acts as a space
+			bPendingSpace = true;
+			Index += 2;
+			while (Index < Code.Len() && !(Code[Index] == TEXT('*') && Index + 1 < Code.Len() && Code[Index + 1] == TEXT('/')))
+			{
+				if (Code[Index] == TEXT('\n'))
+				{
+					PendingLines++;
+				}
+				Index++;
+			}
+			Index = FMath::Min(Index + 2, Code.Len());
+		}
+		else if (Char == TEXT('"'))
+		{
+			Append(Char);
+			Index++;
+			while (Index < Code.Len() && Code[Index] != TEXT('"') && Code[Index] != TEXT('\n'))
+			{
+				if (Code[Index] == TEXT('\\') && Index + 1 < Code.Len() && Code[Index + 1] != TEXT('\n'))
+				{
+					Result += Code[Index++];
+				}
+				Result += Code[Index++];
+			}
+			if (Index < Code.Len() && Code[Index] == TEXT('"'))
+			{
+				Result += Code[Index++];
+			}
+		}
+		else
+		{
+			Append(Char);
+			Index++;
+		}
+	}
+
+	// Trailing blank lines
+	while (!bKeepLineCount && Result.Len() > 0 && LastChar(1) == TEXT('\n') && LastChar(2) != TEXT('\\'))
+	{
+		Result.LeftChopInline(1, false);
+	}
+
+	return Result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FString FHLSLIncrementalParser::Parse(
+	const FHLSLParseOptions& Options,
+	FString Text,
+	TArray<FHLSLParsedFunction>& OutFunctions,
+	TArray<FHLSLParsedStruct>& OutStructs)
+{
+	FHLSLParseResult Result;
+	const FString Error = FHLSLParser::Parse(Options, MoveTemp(Text), Result, &LastResult);
+	if (!Error.IsEmpty())
+	{
+		// Keep the last successful parse: the next edit will be diffed against it
+		return Error;
+	}
+
+	NumParsedDeclarations = 0;
+	for (const FHLSLParsedDeclaration& Declaration : Result.Declarations)
+	{
+		if (!Declaration.bIsFunction || Result.PreviousFunctionIndices[Declaration.Index] == INDEX_NONE)
+		{
+			NumParsedDeclarations++;
+		}
+	}
+
+	PreviousFunctionHashes = MoveTemp(FunctionHashes);
+	FunctionHashes.Reset();
+	FunctionHashes.SetNum(Result.Functions.Num());
+
+	LastResult = MoveTemp(Result);
+
+	OutFunctions.Append(LastResult.Functions);
+	OutStructs.Append(LastResult.Structs);
+
+	return {};
+}
+
+FString FHLSLIncrementalParser::GetFunctionHash(const int32 FunctionIndex, const FString& Key, const TFunctionRef<FString()> GenerateHash)
+{
+	check(FunctionHashes.IsValidIndex(FunctionIndex));
+
+	FFunctionHash& FunctionHash = FunctionHashes[FunctionIndex];
+	if (FunctionHash.Hash.IsEmpty() ||
+		FunctionHash.Key != Key)
+	{
+		const int32 PreviousIndex = LastResult.PreviousFunctionIndices[FunctionIndex];
+		if (PreviousIndex != INDEX_NONE &&
+			PreviousFunctionHashes.IsValidIndex(PreviousIndex) &&
+			PreviousFunctionHashes[PreviousIndex].Key == Key &&
+			!PreviousFunctionHashes[PreviousIndex].Hash.IsEmpty())
+		{
+			FunctionHash = PreviousFunctionHashes[PreviousIndex];
+		}
+		else
+		{
+			FunctionHash.Key = Key;
+			FunctionHash.Hash = GenerateHash();
+		}
+	}
+	return FunctionHash.Hash;
+}
@@ -0,0 +1,10 @@
+// Copyright Phyronnaz
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleInterface.h"
+#include "Modules/ModuleManager.h"
+
+class FHLSLParserModule : public IModuleInterface
+{
+};
+IMPLEMENT_MODULE(FHLSLParserModule, HLSLParser);
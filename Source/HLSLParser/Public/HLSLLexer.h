@@ -0,0 +1,59 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EHLSLTokenType : uint8
+{
+	Identifier,
+	// 1, 1.f, 0x10, 1e-3...
+	Number,
+	// "...", including the quotes
+	String,
+	// Any other single character: { } ( ) [ ] < > , ; = ...
+	Punctuation,
+	// // or /* */, including the delimiters
+	Comment,
+	// Whole # line, including \ continuations
+	Preprocessor
+};
+
+struct FHLSLToken
+{
+	EHLSLTokenType Type = EHLSLTokenType::Punctuation;
+	// Offset into the source text
+	int32 Start = 0;
+	int32 Length = 0;
+	// 1-based
+	int32 Line = 0;
+	int32 Column = 0;
+	// Line of the last character, only differs from Line for block comments and multi-line directives
+	int32 EndLine = 0;
+
+	int32 End() const
+	{
+		return Start + Length;
+	}
+	FStringView GetText(const FStringView Source) const
+	{
+		return Source.Mid(Start, Length);
+	}
+	bool IsPunctuation(const TCHAR Char, const FStringView Source) const
+	{
+		return Type == EHLSLTokenType::Punctuation && Source[Start] == Char;
+	}
+	bool IsIdentifier(const TCHAR* Identifier, const FStringView Source) const
+	{
+		return Type == EHLSLTokenType::Identifier && GetText(Source).Equals(Identifier, ESearchCase::CaseSensitive);
+	}
+};
+
+class HLSLPARSER_API FHLSLLexer
+{
+public:
+	// Splits Text into tokens in a single pass. Whitespace and line breaks are not emitted, use Line/EndLine instead
+	// Returns an error on unterminated comments or strings
+	// Offsets, lines and columns are relative to the start of Text
+	static FString Tokenize(FStringView Text, TArray<FHLSLToken>& OutTokens);
+};
@@ -0,0 +1,321 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "String/Find.h"
+
+// Parsing core shared by the material function and shader library editors
+// Only depends on Core, so it can be driven without loading any asset
+
+// View into the text a parse result came from. The text is shared, so copying a span never copies characters
+// Only call ToString when an owned string is actually needed, eg when building the final custom node code
+struct FHLSLSpan
+{
+	FHLSLSpan() = default;
+	FHLSLSpan(const TSharedRef<const FString>& Source, const int32 Start, const int32 Length)
+		: Source(Source)
+		, Start(Start)
+		, Length(Length)
+	{
+		checkSlow(Start >= 0 && Start + Length <= Source->Len());
+	}
+
+	int32 Len() const
+	{
+		return Length;
+	}
+	bool IsEmpty() const
+	{
+		return Length == 0;
+	}
+	const TCHAR* GetData() const
+	{
+		return Source ? **Source + Start : TEXT("");
+	}
+	int32 GetStart() const
+	{
+		return Start;
+	}
+	FStringView GetView() const
+	{
+		return FStringView(GetData(), Length);
+	}
+	FString ToString() const
+	{
+		return FString(Length, GetData());
+	}
+	// Same characters in another copy of the text, Offset characters further. Used to reuse the spans of a previous parse
+	FHLSLSpan Rebase(const TSharedRef<const FString>& NewSource, const int32 Offset) const
+	{
+		if (!Source)
+		{
+			return {};
+		}
+		return FHLSLSpan(NewSource, Start + Offset, Length);
+	}
+
+	// 1-based line & column of the start of the span in the source. Linear in the offset, only meant for errors
+	void GetLocation(int32& OutLine, int32& OutColumn) const
+	{
+		OutLine = 1;
+		OutColumn = 1;
+		for (int32 Index = 0; Source && Index < Start; Index++)
+		{
+			if ((*Source)[Index] == TEXT('\n'))
+			{
+				OutLine++;
+				OutColumn = 1;
+			}
+			else
+			{
+				OutColumn++;
+			}
+		}
+	}
+
+	bool Equals(const FStringView Other) const
+	{
+		return GetView().Equals(Other, ESearchCase::CaseSensitive);
+	}
+	bool Contains(const FStringView SubString) const
+	{
+		return UE::String::FindFirst(GetView(), SubString, ESearchCase::CaseSensitive) != INDEX_NONE;
+	}
+	bool operator==(const TCHAR* Other) const
+	{
+		return Equals(Other);
+	}
+	bool operator!=(const TCHAR* Other) const
+	{
+		return !Equals(Other);
+	}
+
+	friend FString& operator+=(FString& String, const FHLSLSpan& Span)
+	{
+		String.Append(Span.GetData(), Span.Len());
+		return String;
+	}
+
+	// Serialized as its own characters only: a loaded span points into its own copy, not into the whole text
+	friend FArchive& operator<<(FArchive& Ar, FHLSLSpan& Span)
+	{
+		if (Ar.IsLoading())
+		{
+			FString String;
+			Ar << String;
+			const int32 Length = String.Len();
+			Span = FHLSLSpan(MakeShared<const FString>(MoveTemp(String)), 0, Length);
+		}
+		else
+		{
+			FString String = Span.ToString();
+			Ar << String;
+		}
+		return Ar;
+	}
+
+private:
+	TSharedPtr<const FString> Source;
+	int32 Start = 0;
+	int32 Length = 0;
+};
+
+struct FHLSLParseOptions
+{
+	// Record the line of the opening brace of each function, used to map errors back to the file
+	bool bAccurateErrors = true;
+};
+
+struct FHLSLParsedFunction
+{
+	int32 StartLine = 0;
+	// // comments directly above the function
+	FString Comment;
+	// [Metadata] lines directly above the function
+	FString Metadata;
+	FHLSLSpan ReturnType;
+	FHLSLSpan Name;
+	// As written, including whitespace
+	TArray<FHLSLSpan> Arguments;
+	FHLSLSpan Body;
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLParsedFunction& Function)
+	{
+		Ar << Function.StartLine;
+		Ar << Function.Comment;
+		Ar << Function.Metadata;
+		Ar << Function.ReturnType;
+		Ar << Function.Name;
+		Ar << Function.Arguments;
+		Ar << Function.Body;
+		return Ar;
+	}
+};
+
+struct FHLSLParsedStruct
+{
+	FHLSLSpan Name;
+	FHLSLSpan Body;
+	// Whole declaration, from struct to the closing ;
+	FHLSLSpan Text;
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLParsedStruct& Struct)
+	{
+		Ar << Struct.Name;
+		Ar << Struct.Body;
+		Ar << Struct.Text;
+		return Ar;
+	}
+};
+
+// Character range of a top-level function or struct, including the comments & metadata attached to it
+struct FHLSLParsedDeclaration
+{
+	int32 Start = 0;
+	int32 End = 0;
+	bool bIsFunction = false;
+	// Index in the result functions or structs
+	int32 Index = 0;
+};
+
+struct FHLSLParseResult
+{
+	FHLSLParseOptions Options;
+	// Text with normalized line breaks, all the spans point into it
+	TSharedPtr<const FString> Source;
+	TArray<FHLSLParsedFunction> Functions;
+	TArray<FHLSLParsedStruct> Structs;
+	// In source order
+	TArray<FHLSLParsedDeclaration> Declarations;
+	// For each function, its index in the previous result if it was reused as is, INDEX_NONE if it was parsed
+	TArray<int32> PreviousFunctionIndices;
+};
+
+// A single variable declaration: struct member or function argument
+// [Metadata] const Type<TemplateArguments> Name[ArraySize] : Semantic = DefaultValue
+struct FHLSLParsedDeclarator
+{
+	// Content of the [...] before the declaration, without the brackets. Multiple [...] are joined with a ,
+	FString Metadata;
+	bool bIsConst = false;
+	// out or inout
+	bool bIsOutput = false;
+	// Without the template arguments, eg Texture2D
+	FString Type;
+	// Eg float4 for Texture2D<float4>
+	FString TemplateArguments;
+	FString Name;
+	// Eg 4 for float Values[4]
+	FString ArraySize;
+	FString Semantic;
+	// As written, trimmed
+	FString DefaultValue;
+};
+
+struct FHLSLParsedInclude
+{
+	// As written in the file
+	FString Path;
+	int32 Line = 0;
+};
+
+struct FHLSLParsedDefine
+{
+	FString Name;
+	FString Value;
+	int32 Line = 0;
+};
+
+struct FHLSLParsedPragma
+{
+	FString Type;
+	FString Name;
+	int32 Line = 0;
+};
+
+struct FHLSLParsedDirectives
+{
+	// #include "..."
+	TArray<FHLSLParsedInclude> Includes;
+	// #define NAME VALUE
+	TArray<FHLSLParsedDefine> Defines;
+	// #pragma type name
+	TArray<FHLSLParsedPragma> Pragmas;
+};
+
+class HLSLPARSER_API FHLSLParser
+{
+public:
+	// Returns all the functions with their signature & body, and all the structs, as spans into a single copy of Text
+	// Returns an error if the file could not be parsed
+	static FString Parse(
+		const FHLSLParseOptions& Options,
+		FString Text,
+		TArray<FHLSLParsedFunction>& OutFunctions,
+		TArray<FHLSLParsedStruct>& OutStructs);
+	// If Previous is set, only the declarations overlapping the text edited since are re-tokenized & re-parsed
+	// Everything before and after the edit is reused from Previous
+	static FString Parse(
+		const FHLSLParseOptions& Options,
+		FString Text,
+		FHLSLParseResult& OutResult,
+		const FHLSLParseResult* Previous = nullptr);
+
+	// Parses all the members of a struct body. Comments are ignored
+	// Returns an error with the line & column in the source if a member could not be parsed
+	static FString ParseStructMembers(const FHLSLSpan& Body, TArray<FHLSLParsedDeclarator>& OutMembers);
+	// Parses a single function argument
+	static FString ParseArgument(const FHLSLSpan& Argument, FHLSLParsedDeclarator& OutArgument);
+
+	// Parses a default value: 1.5f, -2, 0x10, float3(1, 2, 3), half2(1.e-3, 0), float4(float3(0), 1)...
+	// A scalar is broadcast to all the components. Doesn't allocate
+	// Returns false if the literal is invalid or doesn't have Dimension components
+	static bool ParseVectorLiteral(FStringView Literal, int32 Dimension, FVector4& OutValue);
+
+	// Collects all the directives in a single pass over the text. Lines are 1-based
+	// Directives inside block comments are ignored
+	static FHLSLParsedDirectives GetDirectives(const FString& Text);
+
+	// True if Identifier appears in Text as a whole word. Comments & strings are not skipped
+	static bool ContainsIdentifier(FStringView Text, FStringView Identifier);
+
+	// Removes the comments, trims the lines & only keeps the spaces needed to separate two tokens. Strings are kept as is
+	// If bKeepLineCount, blank lines are kept so that the lines don't move, otherwise they are removed
+	// Line breaks ending preprocessor directives & line continuations are always kept
+	static FString CanonicalizeCode(FStringView Code, bool bKeepLineCount);
+};
+
+// Keeps the last successful parse of a file, so that the next one only reparses what was edited
+// Also remembers the hashes of the functions, to not recompute them when neither the function nor the base hash changed
+class HLSLPARSER_API FHLSLIncrementalParser
+{
+public:
+	FString Parse(
+		const FHLSLParseOptions& Options,
+		FString Text,
+		TArray<FHLSLParsedFunction>& OutFunctions,
+		TArray<FHLSLParsedStruct>& OutStructs);
+
+	// FunctionIndex is the index in the functions returned by the last Parse
+	// Key is everything else the hash depends on, eg a base hash: the hash is only reused if the key didn't change
+	FString GetFunctionHash(int32 FunctionIndex, const FString& Key, TFunctionRef<FString()> GenerateHash);
+
+	// Number of functions & structs parsed from scratch by the last Parse
+	int32 GetNumParsedDeclarations() const
+	{
+		return NumParsedDeclarations;
+	}
+
+private:
+	FHLSLParseResult LastResult;
+	int32 NumParsedDeclarations = 0;
+
+	struct FFunctionHash
+	{
+		FString Key;
+		FString Hash;
+	};
+	TArray<FFunctionHash> FunctionHashes;
+	TArray<FFunctionHash> PreviousFunctionHashes;
+};
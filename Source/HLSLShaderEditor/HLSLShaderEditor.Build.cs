@@ -35,6 +35,7 @@ public class HLSLShaderEditor : ModuleRules
                 "HLSLShaderRuntime",
                 "HLSLMaterialEditor",
                 "HLSLMaterialRuntime",
+                "HLSLParser",
                 "MaterialEditor",
                 "Landscape",
                 "UnrealEd",
@@ -0,0 +1,365 @@
+// Copyright Phyronnaz
+
+#include "HLSLBenchmarkCommandlet.h"
+#include "HLSLBenchmarkUtilities.h"
+#include "HLSLLexer.h"
+#include "HLSLParser.h"
+#include "HLSLMaterialUtilities.h"
+#include "HLSLShaderLibrary.h"
+#include "ShaderGeneration/HLSLShader.h"
+#include "ShaderGeneration/HLSLShaderGenerator.h"
+#include "ShaderGeneration/HLSLShaderMessages.h"
+#include "ShaderGeneration/HLSLShaderParser.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionFunctionInput.h"
+#include "Misc/FileHelper.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	// Runs every pathological input at Size and 4 * Size chars through each parser & hashing entry point
+	// Fails if a stage doesn't scale linearly (with some slack for noise), or if it's slow enough to freeze the editor
+	int32 RunPathologicalInputs(const int32 Size, const int32 Iterations, const double Slack, const double MaxSeconds)
+	{
+		UHLSLShaderLibrary* Library = NewObject<UHLSLShaderLibrary>(GetTransientPackage());
+		Library->AddToRoot();
+		Library->File.FilePath = TEXT("HLSLBenchmark.hlsl");
+		ON_SCOPE_EXIT
+		{
+			Library->RemoveFromRoot();
+		};
+
+		FHLSLShaderMessages::FLibraryScope Scope(*Library);
+
+		FHLSLParseOptions Options;
+		Options.bAccurateErrors = true;
+
+		using FStage = TFunction<void(const FString& Text)>;
+		TArray<TPair<const TCHAR*, FStage>> Stages;
+		Stages.Add({ TEXT("Tokenize"), [](const FString& Text)
+		{
+			TArray<FHLSLToken> Tokens;
+			FHLSLLexer::Tokenize(Text, Tokens);
+		} });
+		Stages.Add({ TEXT("Parse"), [&](const FString& Text)
+		{
+			FHLSLParseResult Result;
+			FHLSLParser::Parse(Options, Text, Result);
+		} });
+		Stages.Add({ TEXT("Reparse after an edit"), [&](const FString& Text)
+		{
+			// Measured along with the edited parse, but that's at most a factor 2
+			FHLSLParseResult Previous;
+			FHLSLParser::Parse(Options, Text, Previous);
+
+			FString EditedText = Text;
+			EditedText.InsertAt(Text.Len() / 2, TEXT(" "));
+
+			FHLSLParseResult Result;
+			FHLSLParser::Parse(Options, EditedText, Result, &Previous);
+		} });
+		Stages.Add({ TEXT("GetDirectives"), [](const FString& Text)
+		{
+			FHLSLParser::GetDirectives(Text);
+		} });
+		Stages.Add({ TEXT("ParseStructMembers"), [](const FString& Text)
+		{
+			const TSharedRef<const FString> Source = MakeShared<FString>(Text);
+			TArray<FHLSLParsedDeclarator> Members;
+			FHLSLParser::ParseStructMembers(FHLSLSpan(Source, 0, Source->Len()), Members);
+		} });
+		Stages.Add({ TEXT("ParseArgument"), [](const FString& Text)
+		{
+			const TSharedRef<const FString> Source = MakeShared<FString>(Text);
+			FHLSLParsedDeclarator Argument;
+			FHLSLParser::ParseArgument(FHLSLSpan(Source, 0, Source->Len()), Argument);
+		} });
+		Stages.Add({ TEXT("ParseVectorLiteral"), [](const FString& Text)
+		{
+			FVector4 Value;
+			FHLSLParser::ParseVectorLiteral(Text, 4, Value);
+		} });
+		Stages.Add({ TEXT("GetMetaDataFromString"), [&](const FString& Text)
+		{
+			FString MetaString = Text;
+			TArray<FHLSLShaderInputMeta> MetaData;
+			FHLSLShaderInputMeta::GetMetaDataFromString(*Library, MetaString, FunctionInput_Scalar, MetaData);
+		} });
+		Stages.Add({ TEXT("GenerateHashedString"), [](const FString& Text)
+		{
+			FHLSLMaterialShader Shader;
+			Shader.ProcessedBody = Text;
+			Shader.GenerateHashedString({});
+		} });
+
+		int32 NumFailures = 0;
+		const TArray<FHLSLPathologicalInput> SmallInputs = FHLSLBenchmarkUtilities::GeneratePathologicalInputs(Size);
+		const TArray<FHLSLPathologicalInput> LargeInputs = FHLSLBenchmarkUtilities::GeneratePathologicalInputs(4 * Size);
+		check(SmallInputs.Num() == LargeInputs.Num());
+
+		for (int32 InputIndex = 0; InputIndex < SmallInputs.Num(); InputIndex++)
+		{
+			const FString& SmallText = SmallInputs[InputIndex].Text;
+			const FString& LargeText = LargeInputs[InputIndex].Text;
+
+			for (const TPair<const TCHAR*, FStage>& Stage : Stages)
+			{
+				const FHLSLBenchmarkUtilities::FStats SmallStats = FHLSLBenchmarkUtilities::Measure(Iterations, [&] { Stage.Value(SmallText); });
+				const FHLSLBenchmarkUtilities::FStats LargeStats = FHLSLBenchmarkUtilities::Measure(Iterations, [&] { Stage.Value(LargeText); });
+
+				// Below a millisecond the ratio is mostly noise
+				const double ExpectedRatio = double(LargeText.Len()) / FMath::Max(1, SmallText.Len());
+				const double Ratio = LargeStats.Seconds / FMath::Max(SmallStats.Seconds, 1.e-9);
+				const bool bTooSlow = LargeStats.Seconds > MaxSeconds;
+				const bool bNotLinear = LargeStats.Seconds > 1.e-3 && Ratio > ExpectedRatio * Slack;
+
+				if (bTooSlow || bNotLinear)
+				{
+					NumFailures++;
+					UE_LOG(LogHLSLMaterial, Error, TEXT("%-28s %-24s %10.3fms -> %10.3fms (x%.1f for x%.1f chars)%s%s"),
+						*SmallInputs[InputIndex].Name,
+						Stage.Key,
+						SmallStats.Seconds * 1000.,
+						LargeStats.Seconds * 1000.,
+						Ratio,
+						ExpectedRatio,
+						bTooSlow ? TEXT(" too slow") : TEXT(""),
+						bNotLinear ? TEXT(" not linear") : TEXT(""));
+				}
+				else
+				{
+					UE_LOG(LogHLSLMaterial, Display, TEXT("%-28s %-24s %10.3fms -> %10.3fms (x%.1f for x%.1f chars)"),
+						*SmallInputs[InputIndex].Name,
+						Stage.Key,
+						SmallStats.Seconds * 1000.,
+						LargeStats.Seconds * 1000.,
+						Ratio,
+						ExpectedRatio);
+				}
+			}
+		}
+
+		if (NumFailures > 0)
+		{
+			UE_LOG(LogHLSLMaterial, Error, TEXT("%d stages don't scale with the input size"), NumFailures);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+UHLSLBenchmarkCommandlet::UHLSLBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UHLSLBenchmarkCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	const auto GetParam = [&](const TCHAR* Name, const FString& Default)
+	{
+		const FString* Value = ParamsMap.Find(Name);
+		return Value ? *Value : Default;
+	};
+
+	FHLSLCorpusSettings Settings;
+	Settings.Seed = FCString::Atoi(*GetParam(TEXT("Seed"), FString::FromInt(Settings.Seed)));
+	Settings.NumFunctions = FMath::Max(0, FCString::Atoi(*GetParam(TEXT("Functions"), FString::FromInt(Settings.NumFunctions))));
+	Settings.BodyLines = FMath::Max(0, FCString::Atoi(*GetParam(TEXT("BodyLines"), FString::FromInt(Settings.BodyLines))));
+	Settings.NumInputs = FMath::Max(0, FCString::Atoi(*GetParam(TEXT("Inputs"), FString::FromInt(Settings.NumInputs))));
+	// Each static bool doubles the number of custom nodes
+	Settings.NumStaticBools = FMath::Clamp(FCString::Atoi(*GetParam(TEXT("StaticBools"), FString::FromInt(Settings.NumStaticBools))), 0, 10);
+	Settings.MetaDensity = FMath::Clamp(FCString::Atof(*GetParam(TEXT("MetaDensity"), FString::SanitizeFloat(Settings.MetaDensity))), 0.f, 1.f);
+
+	const int32 Iterations = FMath::Max(1, FCString::Atoi(*GetParam(TEXT("Iterations"), TEXT("20"))));
+
+	if (Switches.Contains(TEXT("Pathological")))
+	{
+		const int32 Size = FMath::Max(1, FCString::Atoi(*GetParam(TEXT("Size"), TEXT("16384"))));
+		const double Slack = FMath::Max(1., FCString::Atod(*GetParam(TEXT("Slack"), TEXT("2"))));
+		const double MaxSeconds = FCString::Atod(*GetParam(TEXT("MaxSeconds"), TEXT("0.25")));
+		return RunPathologicalInputs(Size, Iterations, Slack, MaxSeconds);
+	}
+
+	const FString Text = FHLSLBenchmarkUtilities::GenerateCorpus(Settings);
+
+	if (const FString* SavePath = ParamsMap.Find(TEXT("Save")))
+	{
+		if (!FFileHelper::SaveStringToFile(Text, **SavePath))
+		{
+			UE_LOG(LogHLSLMaterial, Error, TEXT("Failed to write %s"), **SavePath);
+			return 1;
+		}
+	}
+
+	UE_LOG(LogHLSLMaterial, Display, TEXT("Corpus: seed %d, %d functions, %d body lines, %d inputs, %d static bools, %.2f meta density: %d chars"),
+		Settings.Seed,
+		Settings.NumFunctions,
+		Settings.BodyLines,
+		Settings.NumInputs,
+		Settings.NumStaticBools,
+		Settings.MetaDensity,
+		Text.Len());
+
+	UHLSLShaderLibrary* Library = NewObject<UHLSLShaderLibrary>(GetTransientPackage());
+	Library->AddToRoot();
+	Library->File.FilePath = TEXT("HLSLBenchmark.hlsl");
+	ON_SCOPE_EXIT
+	{
+		Library->RemoveFromRoot();
+	};
+
+	FHLSLShaderMessages::FLibraryScope Scope(*Library);
+
+	// Parse once to get the inputs of the later stages
+	TArray<FHLSLMaterialShader> Shaders;
+	TArray<FHLSLStruct> Structs;
+	{
+		const FString Error = FHLSLShaderParser::Parse(*Library, Text, Shaders, Structs);
+		if (!Error.IsEmpty())
+		{
+			UE_LOG(LogHLSLMaterial, Error, TEXT("Parsing failed: %s"), *Error);
+			return 1;
+		}
+	}
+
+	FHLSLMaterialShader* PixelShader = Shaders.FindByPredicate([](const FHLSLMaterialShader& Shader)
+	{
+		return Shader.Name == TEXT("PSMain");
+	});
+	const FHLSLStruct* InputStruct = Structs.FindByPredicate([](const FHLSLStruct& Struct)
+	{
+		return Struct.Name == TEXT("PSInput");
+	});
+	const FHLSLStruct* OutputStruct = Structs.FindByPredicate([](const FHLSLStruct& Struct)
+	{
+		return Struct.Name == TEXT("PSOutput");
+	});
+	check(PixelShader && InputStruct && OutputStruct);
+
+	FHLSLMaterialShader& Shader = *PixelShader;
+	Shader.ShaderStage = FHLSLMaterialShader::PIXEL_SHADER;
+	Shader.InputStruct_Raw = *InputStruct;
+	Shader.InputStruct_Raw.ShaderStage = FHLSLMaterialShader::PS_INPUT;
+	Shader.OutputStruct_Raw = *OutputStruct;
+	Shader.OutputStruct_Raw.ShaderStage = FHLSLMaterialShader::PS_OUTPUT;
+	Shader.ProcessedBody = Shader.Body.ToString().Replace(TEXT("pin."), TEXT("")).Replace(TEXT("pout."), TEXT(""));
+	{
+		const FString InputErrors = FHLSLShaderParser::ParseInputStructs(*Library, Shader.InputStruct_Raw, Shader.Inputs);
+		const FString OutputErrors = FHLSLShaderParser::ParseOutputStructs(*Library, Shader.OutputStruct_Raw, Shader.Outputs);
+		if (!InputErrors.IsEmpty() || !OutputErrors.IsEmpty())
+		{
+			UE_LOG(LogHLSLMaterial, Error, TEXT("Invalid structs: (%s) (%s)"), *InputErrors, *OutputErrors);
+			return 1;
+		}
+	}
+	Shader.HashedString = Shader.GenerateHashedString({});
+
+	const auto LogStage = [&](const TCHAR* Name, const int32 NumChars, const FHLSLBenchmarkUtilities::FStats& Stats)
+	{
+		UE_LOG(LogHLSLMaterial, Display, TEXT("%-24s %10.3fms %10.2fns/byte %10lld allocs %10lldKB peak (%d chars)"),
+			Name,
+			Stats.Seconds * 1000.,
+			Stats.Seconds * 1.e9 / FMath::Max<int64>(1, NumChars * sizeof(TCHAR)),
+			Stats.NumAllocations,
+			Stats.PeakBytes / 1024,
+			NumChars);
+	};
+
+	FHLSLParseOptions Options;
+	Options.bAccurateErrors = Library->bAccurateErrors;
+
+	LogStage(TEXT("Parse"), Text.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+	{
+		FHLSLParseResult Result;
+		FHLSLParser::Parse(Options, Text, Result);
+	}));
+
+	// Edit the body of the function in the middle of the file, like a save in a text editor would
+	{
+		FHLSLParseResult Previous;
+		FHLSLParser::Parse(Options, Text, Previous);
+
+		FString EditedText = Text;
+		if (Previous.Functions.Num() > 0)
+		{
+			const FHLSLSpan& Body = Previous.Functions[Previous.Functions.Num() / 2].Body;
+			EditedText.InsertAt(Body.GetStart(), TEXT("\n\tValue += 1;"));
+		}
+
+		LogStage(TEXT("Reparse after an edit"), EditedText.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+		{
+			FHLSLParseResult Result;
+			FHLSLParser::Parse(Options, EditedText, Result, &Previous);
+		}));
+	}
+
+	LogStage(TEXT("GetDirectives"), Text.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+	{
+		FHLSLShaderParser::GetDirectives(Library->File.FilePath, Text);
+	}));
+
+	LogStage(TEXT("ParseInputStructs"), Shader.InputStruct_Raw.Body.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+	{
+		TArray<FHLSLShaderInput> Inputs;
+		FHLSLShaderParser::ParseInputStructs(*Library, Shader.InputStruct_Raw, Inputs);
+	}));
+
+	{
+		int32 NumMetaChars = 0;
+		for (const FHLSLShaderInput& Input : Shader.Inputs)
+		{
+			NumMetaChars += Input.MetaStringRaw.Len();
+		}
+
+		LogStage(TEXT("GetMetaDataFromString"), NumMetaChars, FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+		{
+			for (const FHLSLShaderInput& Input : Shader.Inputs)
+			{
+				FString MetaString = Input.MetaStringRaw;
+				TArray<FHLSLShaderInputMeta> MetaData;
+				FHLSLShaderInputMeta::GetMetaDataFromString(*Library, MetaString, Input.InputType, MetaData);
+			}
+		}));
+	}
+
+	LogStage(TEXT("GenerateHashedString"), Shader.ProcessedBody.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+	{
+		Shader.GenerateHashedString({});
+	}));
+
+	// Generate every permutation into a new material each time
+	{
+		// Measure runs the lambda twice more than Iterations
+		TArray<UMaterial*> Materials;
+		for (int32 Index = 0; Index < Iterations + 2; Index++)
+		{
+			UMaterial* Material = NewObject<UMaterial>(GetTransientPackage());
+			Material->AddToRoot();
+			Materials.Add(Material);
+		}
+
+		int32 MaterialIndex = 0;
+		const FString Name = FString::Printf(TEXT("GenerateShader (%d permutations)"), 1 << Settings.NumStaticBools);
+		LogStage(*Name, Shader.ProcessedBody.Len(), FHLSLBenchmarkUtilities::Measure(Iterations, [&]
+		{
+			Library->Materials = Materials[MaterialIndex++];
+			FHLSLShaderGenerator::GenerateShader(*Library, {}, {}, Shader, {});
+		}));
+
+		Library->Materials = nullptr;
+		for (UMaterial* Material : Materials)
+		{
+			Material->RemoveFromRoot();
+		}
+	}
+
+	return 0;
+}
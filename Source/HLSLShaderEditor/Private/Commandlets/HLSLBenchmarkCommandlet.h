@@ -0,0 +1,23 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "HLSLBenchmarkCommandlet.generated.h"
+
+// Times each stage of the shader library generation on a synthetic file, reporting ns/byte, allocations & peak memory
+// UnrealEditor-Cmd Project.uproject -run=HLSLBenchmark [-Functions=8] [-BodyLines=32] [-Inputs=16] [-StaticBools=3] [-MetaDensity=0.5] [-Seed=0] [-Iterations=20] [-Save=Path/To/Corpus.hlsl]
+// Malformed & extreme files, failing if a stage doesn't scale linearly: -run=HLSLBenchmark -Pathological [-Size=16384] [-Slack=2] [-MaxSeconds=0.25] [-Iterations=20]
+UCLASS()
+class UHLSLBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UHLSLBenchmarkCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,301 @@
+// Copyright Phyronnaz
+
+#include "HLSLBenchmarkUtilities.h"
+#include "Math/RandomStream.h"
+#include <atomic>
+
+namespace
+{
+	// Forwards everything to the real allocator, counting the allocations & the live bytes
+	// If the allocator can't tell the size of an allocation, frees are not counted and the peak is the total allocated
+	class FHLSLCountingMalloc final : public FMalloc
+	{
+	public:
+		FMalloc* Inner = nullptr;
+
+		std::atomic<int64> NumAllocations{ 0 };
+		std::atomic<int64> LiveBytes{ 0 };
+		std::atomic<int64> PeakBytes{ 0 };
+
+		void Reset()
+		{
+			NumAllocations = 0;
+			LiveBytes = 0;
+			PeakBytes = 0;
+		}
+
+		//~ Begin FMalloc Interface
+		virtual void* Malloc(const SIZE_T Count, const uint32 Alignment) override
+		{
+			void* Result = Inner->Malloc(Count, Alignment);
+			OnAllocated(Result, Count);
+			return Result;
+		}
+		virtual void* Realloc(void* Original, const SIZE_T Count, const uint32 Alignment) override
+		{
+			OnFreed(Original);
+			void* Result = Inner->Realloc(Original, Count, Alignment);
+			OnAllocated(Result, Count);
+			return Result;
+		}
+		virtual void Free(void* Original) override
+		{
+			OnFreed(Original);
+			Inner->Free(Original);
+		}
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+		virtual SIZE_T QuantizeSize(const SIZE_T Count, const uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+		virtual void Trim(const bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			Inner->SetupTLSCachesOnCurrentThread();
+		}
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			Inner->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+		virtual bool ValidateHeap() override
+		{
+			return Inner->ValidateHeap();
+		}
+		virtual void UpdateStats() override
+		{
+			Inner->UpdateStats();
+		}
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+		{
+			Inner->GetAllocatorStats(OutStats);
+		}
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+		{
+			Inner->DumpAllocatorStats(Ar);
+		}
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("HLSLCountingMalloc");
+		}
+		//~ End FMalloc Interface
+
+	private:
+		void OnAllocated(void* Pointer, const SIZE_T Count)
+		{
+			if (!Pointer)
+			{
+				return;
+			}
+
+			SIZE_T Size = Count;
+			Inner->GetAllocationSize(Pointer, Size);
+
+			NumAllocations++;
+
+			const int64 NewLiveBytes = LiveBytes += Size;
+			int64 OldPeakBytes = PeakBytes.load();
+			while (NewLiveBytes > OldPeakBytes && !PeakBytes.compare_exchange_weak(OldPeakBytes, NewLiveBytes))
+			{
+			}
+		}
+		void OnFreed(void* Pointer)
+		{
+			SIZE_T Size = 0;
+			if (Pointer && Inner->GetAllocationSize(Pointer, Size))
+			{
+				LiveBytes -= Size;
+			}
+		}
+	};
+
+	void AppendBody(FRandomStream& Random, const int32 BodyLines, FString& Text)
+	{
+		for (int32 Line = 0; Line < BodyLines; Line++)
+		{
+			switch (Random.RandRange(0, 4))
+			{
+			case 0:
+			{
+				Text += FString::Printf(TEXT("\tValue = Value * %.2ff + Scale;\n"), Random.FRandRange(0.f, 2.f));
+			}
+			break;
+			case 1:
+			{
+				Text += FString::Printf(TEXT("\tValue = lerp(Value, Value.yzx, saturate(Scale * %.2ff));\n"), Random.FRand());
+			}
+			break;
+			case 2:
+			{
+				Text += FString::Printf(TEXT("\t// Step %d: keep the value in range\n"), Line);
+			}
+			break;
+			case 3:
+			{
+				Text += FString::Printf(TEXT("\tif (Value.x > %.2ff)\n\t{\n\t\tValue = sin(Value);\n\t}\n"), Random.FRand());
+			}
+			break;
+			default:
+			{
+				Text += FString::Printf(TEXT("\tfor (int Index = 0; Index < %d; Index++)\n\t{\n\t\tValue += Index * Scale;\n\t}\n"), Random.RandRange(1, 8));
+			}
+			break;
+			}
+		}
+	}
+}
+
+FString FHLSLBenchmarkUtilities::GenerateCorpus(const FHLSLCorpusSettings& Settings)
+{
+	FRandomStream Random(Settings.Seed);
+
+	FString Text;
+	Text += FString::Printf(TEXT("// Generated by -run=HLSLBenchmark with seed %d\n\n"), Settings.Seed);
+	Text += TEXT("#pragma fragment PSMain\n");
+	Text += TEXT("#pragma psin PSInput\n");
+	Text += TEXT("#pragma psout PSOutput\n\n");
+
+	const auto RandomFloat = [&]
+	{
+		return FString::Printf(TEXT("%.3ff"), Random.FRandRange(-10.f, 10.f));
+	};
+
+	TArray<int32> InputDimensions;
+	Text += TEXT("struct PSInput\n{\n");
+	for (int32 Index = 0; Index < Settings.NumInputs; Index++)
+	{
+		const int32 Dimension = InputDimensions.Add_GetRef(Random.RandRange(1, 4));
+
+		if (Random.FRand() < Settings.MetaDensity)
+		{
+			Text += FString::Printf(TEXT("\t[Group(Group%d)]\n"), Random.RandRange(0, 3));
+		}
+		if (Dimension == 1 && Random.FRand() < Settings.MetaDensity)
+		{
+			Text += TEXT("\t[Range(-10, 10)]\n");
+		}
+
+		if (Dimension == 1)
+		{
+			Text += FString::Printf(TEXT("\tfloat Input%d = %s;\n"), Index, *RandomFloat());
+		}
+		else
+		{
+			FString DefaultValue;
+			for (int32 Component = 0; Component < Dimension; Component++)
+			{
+				DefaultValue += (Component > 0 ? TEXT(", ") : TEXT("")) + RandomFloat();
+			}
+			Text += FString::Printf(TEXT("\tfloat%d Input%d = float%d(%s);\n"), Dimension, Index, Dimension, *DefaultValue);
+		}
+	}
+	for (int32 Index = 0; Index < Settings.NumStaticBools; Index++)
+	{
+		Text += FString::Printf(TEXT("\tbool bStatic%d = %s;\n"), Index, Random.FRand() < 0.5f ? TEXT("true") : TEXT("false"));
+	}
+	Text += TEXT("};\n\n");
+
+	Text += TEXT("struct PSOutput\n{\n\tfloat3 Color : EMISSIVE;\n};\n\n");
+
+	for (int32 Index = 0; Index < Settings.NumFunctions; Index++)
+	{
+		Text += FString::Printf(TEXT("// Helper %d\n// @param Value The value to transform\nfloat3 Helper%d(float3 Value, float Scale)\n{\n"), Index, Index);
+		AppendBody(Random, Settings.BodyLines, Text);
+		Text += TEXT("\treturn Value;\n}\n\n");
+	}
+
+	Text += TEXT("void PSMain(FMaterialPixelParameters Parameters, PSInput pin, out PSOutput pout)\n{\n");
+	Text += TEXT("\tfloat3 Value = 0;\n\tfloat Scale = 1;\n");
+	for (int32 Index = 0; Index < InputDimensions.Num(); Index++)
+	{
+		static const TCHAR* Swizzles[] = { TEXT(""), TEXT(".xyx"), TEXT(""), TEXT(".xyz") };
+		Text += FString::Printf(TEXT("\tValue += pin.Input%d%s;\n"), Index, Swizzles[InputDimensions[Index] - 1]);
+	}
+	for (int32 Index = 0; Index < Settings.NumStaticBools; Index++)
+	{
+		Text += FString::Printf(TEXT("\tif (pin.bStatic%d)\n\t{\n\t\tValue = Value.zxy;\n\t}\n"), Index);
+	}
+	AppendBody(Random, Settings.BodyLines, Text);
+	Text += TEXT("\tpout.Color = Value;\n}\n");
+
+	return Text;
+}
+
+TArray<FHLSLPathologicalInput> FHLSLBenchmarkUtilities::GeneratePathologicalInputs(const int32 Size)
+{
+	// Whole copies of Pattern, at least Length chars
+	const auto Repeat = [](const TCHAR* Pattern, const int32 Length)
+	{
+		FString Result;
+		Result.Reserve(Length + FCString::Strlen(Pattern));
+		while (Result.Len() < Length)
+		{
+			Result += Pattern;
+		}
+		return Result;
+	};
+
+	TArray<FHLSLPathologicalInput> Inputs;
+	Inputs.Add({ TEXT("Long line"), TEXT("float3 Main(float3 Value) { return Value") + Repeat(TEXT(" + Value.x * 2.5f"), Size) + TEXT("; }\n") });
+	Inputs.Add({ TEXT("Deep nesting"), TEXT("void Main() ") + Repeat(TEXT("{"), Size / 2) + Repeat(TEXT("}"), Size / 2) + TEXT("\n") });
+	Inputs.Add({ TEXT("Unterminated nesting"), TEXT("void Main() ") + Repeat(TEXT("{"), Size) });
+	{
+		const int32 Depth = Size / 7;
+		Inputs.Add({ TEXT("Nested constructors"), Repeat(TEXT("float("), Depth * 6) + TEXT("1") + Repeat(TEXT(")"), Depth) });
+	}
+	Inputs.Add({ TEXT("Unterminated parentheses"), TEXT("void Main") + Repeat(TEXT("("), Size) });
+	Inputs.Add({ TEXT("Huge block comment"), TEXT("/*") + Repeat(TEXT("comment "), Size) + TEXT("*/\nvoid Main() {}\n") });
+	Inputs.Add({ TEXT("Unterminated block comment"), TEXT("/*") + Repeat(TEXT("comment "), Size) });
+	Inputs.Add({ TEXT("Line comments"), Repeat(TEXT("// comment\n"), Size) + TEXT("void Main() {}\n") });
+	Inputs.Add({ TEXT("Whitespace runs"), TEXT("void Main()\n{") + Repeat(TEXT(" \t  \n"), Size) + TEXT("}\n") });
+	Inputs.Add({ TEXT("Metadata"), Repeat(TEXT("[Group(A), Range(0, 1), Key = \"Value\"]\n"), Size) + TEXT("void Main() {}\n") });
+	Inputs.Add({ TEXT("Unterminated metadata"), Repeat(TEXT("["), Size) });
+	Inputs.Add({ TEXT("Unterminated quotes"), Repeat(TEXT("Key = \""), Size) });
+	Inputs.Add({ TEXT("Line continuations"), TEXT("#define Value \\\n") + Repeat(TEXT("\t1 + \\\n"), Size) + TEXT("\n") });
+
+	return Inputs;
+}
+
+FHLSLBenchmarkUtilities::FStats FHLSLBenchmarkUtilities::Measure(const int32 Iterations, const TFunctionRef<void()> Lambda)
+{
+	check(Iterations > 0);
+
+	// Warm up any lazily initialized state
+	Lambda();
+
+	FStats Stats;
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Lambda();
+		}
+		Stats.Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+	}
+
+	// Static: another thread might still be inside it after GMalloc is restored
+	static FHLSLCountingMalloc CountingMalloc;
+	check(GMalloc != &CountingMalloc);
+
+	CountingMalloc.Inner = GMalloc;
+	CountingMalloc.Reset();
+	GMalloc = &CountingMalloc;
+	{
+		Lambda();
+	}
+	GMalloc = CountingMalloc.Inner;
+
+	Stats.NumAllocations = CountingMalloc.NumAllocations;
+	Stats.PeakBytes = CountingMalloc.PeakBytes;
+
+	return Stats;
+}
@@ -0,0 +1,49 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FHLSLCorpusSettings
+{
+	// Same seed & settings always generate the same file
+	int32 Seed = 0;
+	// Helper functions, on top of the pixel shader
+	int32 NumFunctions = 8;
+	// Statements in each function body
+	int32 BodyLines = 32;
+	// Float inputs of the pixel shader
+	int32 NumInputs = 16;
+	// Bool inputs of the pixel shader, each one doubles the permutations
+	int32 NumStaticBools = 3;
+	// Chance of each input to have meta tags, between 0 and 1
+	float MetaDensity = 0.5f;
+};
+
+struct FHLSLPathologicalInput
+{
+	FString Name;
+	FString Text;
+};
+
+class FHLSLBenchmarkUtilities
+{
+public:
+	// Shader library file with a pixel shader, its input & output structs and helper functions
+	static FString GenerateCorpus(const FHLSLCorpusSettings& Settings);
+	// Malformed or extreme files of roughly Size chars: long lines, deep nesting, huge comments, whitespace runs, unterminated scopes...
+	static TArray<FHLSLPathologicalInput> GeneratePathologicalInputs(int32 Size);
+
+	struct FStats
+	{
+		// Average over all the iterations
+		double Seconds = 0;
+		// Of a single iteration
+		int64 NumAllocations = 0;
+		// Highest increase of the live memory during a single iteration
+		int64 PeakBytes = 0;
+	};
+	// Runs Lambda once to warm up, Iterations times to time it, and once more with GMalloc wrapped to count the allocations
+	// Allocations made by other threads in the meantime are counted too
+	static FStats Measure(int32 Iterations, TFunctionRef<void()> Lambda);
+};
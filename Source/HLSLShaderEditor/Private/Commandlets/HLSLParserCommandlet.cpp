@@ -0,0 +1,106 @@
+// Copyright Phyronnaz
+
+#include "HLSLParserCommandlet.h"
+#include "HLSLParser.h"
+#include "HLSLMaterialUtilities.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UHLSLParserCommandlet::UHLSLParserCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UHLSLParserCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	const FString* FilesParam = ParamsMap.Find(TEXT("File"));
+	if (!FilesParam)
+	{
+		UE_LOG(LogHLSLMaterial, Error, TEXT("Usage: -run=HLSLParser -File=Path/To/File.hlsl[+Other.hlsl] [-Iterations=100]"));
+		return 1;
+	}
+
+	const int32 Iterations = FMath::Max(1, ParamsMap.Contains(TEXT("Iterations")) ? FCString::Atoi(*ParamsMap[TEXT("Iterations")]) : 100);
+
+	TArray<FString> Files;
+	FilesParam->ParseIntoArray(Files, TEXT("+"));
+
+	int32 NumErrors = 0;
+	for (const FString& File : Files)
+	{
+		const FString FullPath = FPaths::ConvertRelativePathToFull(File);
+
+		FString Text;
+		if (!FFileHelper::LoadFileToString(Text, *FullPath))
+		{
+			UE_LOG(LogHLSLMaterial, Error, TEXT("Failed to read %s"), *FullPath);
+			NumErrors++;
+			continue;
+		}
+
+		// Correctness: parse once and dump what we found
+		{
+			TArray<FHLSLParsedFunction> Functions;
+			TArray<FHLSLParsedStruct> Structs;
+			const FString Error = FHLSLParser::Parse({}, Text, Functions, Structs);
+			if (!Error.IsEmpty())
+			{
+				UE_LOG(LogHLSLMaterial, Error, TEXT("%s: parsing failed: %s"), *FullPath, *Error);
+				NumErrors++;
+				continue;
+			}
+
+			const FHLSLParsedDirectives Directives = FHLSLParser::GetDirectives(Text);
+			UE_LOG(LogHLSLMaterial, Display, TEXT("%s: %d functions, %d structs, %d includes, %d defines, %d pragmas"),
+				*FullPath,
+				Functions.Num(),
+				Structs.Num(),
+				Directives.Includes.Num(),
+				Directives.Defines.Num(),
+				Directives.Pragmas.Num());
+
+			for (const FHLSLParsedFunction& Function : Functions)
+			{
+				UE_LOG(LogHLSLMaterial, Display, TEXT("    %s %s, %d arguments, line %d, %d chars"),
+					*Function.ReturnType.ToString(),
+					*Function.Name.ToString(),
+					Function.Arguments.Num(),
+					Function.StartLine + 1,
+					Function.Body.Len());
+			}
+			for (const FHLSLParsedStruct& Struct : Structs)
+			{
+				UE_LOG(LogHLSLMaterial, Display, TEXT("    struct %s, %d chars"), *Struct.Name.ToString(), Struct.Body.Len());
+			}
+		}
+
+		// Throughput
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+			{
+				TArray<FHLSLParsedFunction> Functions;
+				TArray<FHLSLParsedStruct> Structs;
+				FHLSLParser::Parse({}, Text, Functions, Structs);
+				FHLSLParser::GetDirectives(Text);
+			}
+			const double Seconds = (FPlatformTime::Seconds() - StartTime) / Iterations;
+
+			UE_LOG(LogHLSLMaterial, Display, TEXT("%s: %d chars parsed in %.3fms (%.2f MB/s)"),
+				*FullPath,
+				Text.Len(),
+				Seconds * 1000.,
+				Text.Len() * sizeof(TCHAR) / Seconds / (1024. * 1024.));
+		}
+	}
+
+	return NumErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+// Copyright Phyronnaz
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "HLSLParserCommandlet.generated.h"
+
+// Parses HLSL files headless and reports the parse results and throughput, without opening the editor
+// UnrealEditor-Cmd Project.uproject -run=HLSLParser -File=Path/To/File.hlsl [-Iterations=100]
+UCLASS()
+class UHLSLParserCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UHLSLParserCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -1,9 +1,8 @@
 ﻿#include "HLSLDependencyHandler.h"
 
 #include "HLSLMaterialUtilities.h"
-#include "Internationalization/Regex.h"
 #include "Materials/Material.h"
-#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpression.h"
 #include "Materials/MaterialExpressionSceneTexture.h"
 #include "Materials/MaterialExpressionTextureCoordinate.h"
 #include "Materials/MaterialExpressionVertexColor.h"
@@ -15,114 +14,107 @@
 #include "Materials/MaterialExpressionSkyAtmosphereLightIlluminance.h"
 #endif
 
-void FHLSLDependency_TexCoords::EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode,
-                                                   const FString& ShaderBody) const
+TArray<FHLSLDependencyHandler::FDummy> FHLSLDependencyHandler::CreateDummies(const TArray<TUniquePtr<FHLSLDependencyHandler>>& Handlers,
+	UMaterial* Material, const FString& ShaderBody)
 {
-	// Create a dummy texture coordinate index to ensure NUM_TEX_COORD_INTERPOLATORS is correct
-	// Detect used texture coordinates
-	int32 MaxTexCoordinateUsed = -1;
+	TArray<bool> Found;
+	Found.SetNumZeroed(Handlers.Num());
+	TArray<int32> States;
+	States.Init(INDEX_NONE, Handlers.Num());
+
+	// Only compare each char against the tokens starting with it
+	TMap<TCHAR, TArray<int32, TInlineAllocator<2>>> HandlersByFirstChar;
+	for (int32 Index = 0; Index < Handlers.Num(); Index++)
+	{
+		HandlersByFirstChar.FindOrAdd(Handlers[Index]->GetToken()[0]).Add(Index);
+	}
+
+	const FStringView Body = ShaderBody;
+	for (int32 Position = 0; Position < Body.Len(); Position++)
 	{
-		FRegexPattern RegexPattern(R"_(Parameters.TexCoords\[([0-9]+)\])_");
-		FRegexMatcher RegexMatcher(RegexPattern, ShaderBody);
-		while (RegexMatcher.FindNext())
+		const TArray<int32, TInlineAllocator<2>>* Candidates = HandlersByFirstChar.Find(Body[Position]);
+		if (!Candidates) continue;
+
+		const FStringView Suffix = Body.RightChop(Position);
+		for (const int32 Index : *Candidates)
 		{
-			MaxTexCoordinateUsed = FMath::Max(MaxTexCoordinateUsed, FCString::Atoi(*RegexMatcher.GetCaptureGroup(1)));
+			const FStringView Token = Handlers[Index]->GetToken();
+			if (Suffix.StartsWith(Token, ESearchCase::CaseSensitive) &&
+				Handlers[Index]->OnTokenFound(Suffix.RightChop(Token.Len()), States[Index]))
+			{
+				Found[Index] = true;
+			}
 		}
 	}
 
-	if (MaxTexCoordinateUsed == -1) return;
-	
+	TArray<FDummy> Dummies;
+	for (int32 Index = 0; Index < Handlers.Num(); Index++)
+	{
+		if (!Found[Index]) continue;
+
+		UMaterialExpression* Expression = Handlers[Index]->CreateDummyExpression(Material, States[Index]);
+		if (!Expression) continue;
+
+		// Left of the custom nodes, above the first one
+		Expression->MaterialExpressionGuid = FGuid::NewGuid();
+		Expression->bCollapsed = true;
+		Expression->MaterialExpressionEditorX = 300;
+		Expression->MaterialExpressionEditorY = -300 - 100 * Dummies.Num();
+		Material->FunctionExpressions.Add(Expression);
+
+		Dummies.Add({ Handlers[Index]->GetInputName(), Expression });
+	}
+	return Dummies;
+}
+
+bool FHLSLDependency_TexCoords::OnTokenFound(FStringView Suffix, int32& State) const
+{
+	// Parameters.TexCoords[Index], with a literal index
+	int32 NumDigits = 0;
+	while (NumDigits < Suffix.Len() && FChar::IsDigit(Suffix[NumDigits]))
+	{
+		NumDigits++;
+	}
+	if (NumDigits == 0 || NumDigits == Suffix.Len() || Suffix[NumDigits] != TEXT(']')) return false;
+
+	State = FMath::Max(State, FCString::Atoi(*FString(Suffix.Left(NumDigits))));
+	return true;
+}
+
+UMaterialExpression* FHLSLDependency_TexCoords::CreateDummyExpression(UMaterial* Material, int32 State) const
+{
+	// Create a dummy texture coordinate index to ensure NUM_TEX_COORD_INTERPOLATORS is correct
 	UMaterialExpressionTextureCoordinate* TextureCoordinate = NewObject<UMaterialExpressionTextureCoordinate>(Material);
-	TextureCoordinate->MaterialExpressionGuid = FGuid::NewGuid();
-	TextureCoordinate->bCollapsed = true;
-	TextureCoordinate->CoordinateIndex = MaxTexCoordinateUsed;
-	TextureCoordinate->MaterialExpressionEditorX = HLSLNode->MaterialExpressionEditorX - 200;
-	TextureCoordinate->MaterialExpressionEditorY = HLSLNode->MaterialExpressionEditorY;
-	Material->FunctionExpressions.Add(TextureCoordinate);
-
-	FCustomInput& CustomInput = HLSLNode->Inputs.Emplace_GetRef();
-	CustomInput.InputName = "DUMMY_COORDINATE_INPUT";
-	CustomInput.Input.Connect(0, TextureCoordinate);
+	TextureCoordinate->CoordinateIndex = State;
+	return TextureCoordinate;
 }
 
-void FHLSLDependency_SceneTexture::EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode,
-	const FString& ShaderBody) const
+UMaterialExpression* FHLSLDependency_SceneTexture::CreateDummyExpression(UMaterial* Material, int32 State) const
 {
-	// Detect used scene texture look-up
-	const bool bSceneTextureUsed = ShaderBody.Contains("SceneTextureLookup", ESearchCase::CaseSensitive);
-	if (!bSceneTextureUsed) return;
-	
 	UMaterialExpressionSceneTexture* SceneTexture = NewObject<UMaterialExpressionSceneTexture>(Material);
-	SceneTexture->MaterialExpressionGuid = FGuid::NewGuid();
-	SceneTexture->bCollapsed = true;
 	SceneTexture->SceneTextureId = ESceneTextureId::PPI_PostProcessInput0;
-	SceneTexture->MaterialExpressionEditorX = HLSLNode->MaterialExpressionEditorX - 200;
-	SceneTexture->MaterialExpressionEditorY = HLSLNode->MaterialExpressionEditorY;
-	Material->FunctionExpressions.Add(SceneTexture);
-
-	FCustomInput& CustomInput = HLSLNode->Inputs.Emplace_GetRef();
-	CustomInput.InputName = "DUMMY_SCENETEX_INPUT";
-	CustomInput.Input.Connect(0, SceneTexture);
+	return SceneTexture;
 }
 
-void FHLSLDependency_VertexColors::EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode,
-	const FString& ShaderBody) const
+UMaterialExpression* FHLSLDependency_VertexColors::CreateDummyExpression(UMaterial* Material, int32 State) const
 {
 	// Create a dummy vertex color parameter to ensure INTERPOLATE_VERTEX_COLOR is correct
-	// Detect used vertex colors
-	const bool bVertexColorUsed = ShaderBody.Contains("Parameters.VertexColor", ESearchCase::CaseSensitive);
-	if (!bVertexColorUsed) return;
-	
-	UMaterialExpressionVertexColor* Color = NewObject<UMaterialExpressionVertexColor>(Material);
-	Color->MaterialExpressionGuid = FGuid::NewGuid();
-	Color->bCollapsed = true;
-	Color->MaterialExpressionEditorX = HLSLNode->MaterialExpressionEditorX - 200;
-	Color->MaterialExpressionEditorY = HLSLNode->MaterialExpressionEditorY;
-	Material->FunctionExpressions.Add(Color);
-
-	FCustomInput& CustomInput = HLSLNode->Inputs.Emplace_GetRef();
-	CustomInput.InputName = "DUMMY_COLOR_INPUT";
-	CustomInput.Input.Connect(0, Color);
+	return NewObject<UMaterialExpressionVertexColor>(Material);
 }
 
-void FHLSLDependency_WPOExcludingOffsets::EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode,
-	const FString& ShaderBody) const
+UMaterialExpression* FHLSLDependency_WPOExcludingOffsets::CreateDummyExpression(UMaterial* Material, int32 State) const
 {
 	// Create a dummy world position node to ensure NEEDS_WORLD_POSITION_EXCLUDING_SHADER_OFFSETS is correct
-	// Detect whether NEEDS_WORLD_POSITION_EXCLUDING_SHADER_OFFSETS is required
-	const bool bNeedsWorldPositionExcludingShaderOffsets = ShaderBody.Contains("GetWorldPosition_NoMaterialOffsets", ESearchCase::CaseSensitive);
-	if (!bNeedsWorldPositionExcludingShaderOffsets) return;
-	
 	UMaterialExpressionWorldPosition* WorldPosition = NewObject<UMaterialExpressionWorldPosition>(Material);
-	WorldPosition->MaterialExpressionGuid = FGuid::NewGuid();
-	WorldPosition->bCollapsed = true;
 	WorldPosition->WorldPositionShaderOffset = WPT_ExcludeAllShaderOffsets;
-	WorldPosition->MaterialExpressionEditorX = HLSLNode->MaterialExpressionEditorX - 200;
-	WorldPosition->MaterialExpressionEditorY = HLSLNode->MaterialExpressionEditorY;
-	Material->FunctionExpressions.Add(WorldPosition);
-
-	FCustomInput& CustomInput = HLSLNode->Inputs.Emplace_GetRef();
-	CustomInput.InputName = "DUMMY_WORLD_POSITION_INPUT";
-	CustomInput.Input.Connect(0, WorldPosition);
+	return WorldPosition;
 }
 
-void FHLSLDependency_SkyAtmosphere::EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode,
-	const FString& ShaderBody) const
+UMaterialExpression* FHLSLDependency_SkyAtmosphere::CreateDummyExpression(UMaterial* Material, int32 State) const
 {
 #if SKYATMOSPHERE_ALLOWED
-	// Detect if any sky atmosphere expressions are used
-	const bool bSkyAtmosphereUsed = ShaderBody.Contains("MaterialExpressionSkyAtmosphere", ESearchCase::CaseSensitive);
-	if (!bSkyAtmosphereUsed) return;
-	
-	UMaterialExpressionSkyAtmosphereLightIlluminance* SkyAtmosphere = NewObject<UMaterialExpressionSkyAtmosphereLightIlluminance>(Material);
-	SkyAtmosphere->MaterialExpressionGuid = FGuid::NewGuid();
-	SkyAtmosphere->bCollapsed = true;
-	SkyAtmosphere->MaterialExpressionEditorX = HLSLNode->MaterialExpressionEditorX - 200;
-	SkyAtmosphere->MaterialExpressionEditorY = HLSLNode->MaterialExpressionEditorY;
-	Material->FunctionExpressions.Add(SkyAtmosphere);
-
-	FCustomInput& CustomInput = HLSLNode->Inputs.Emplace_GetRef();
-	CustomInput.InputName = "DUMMY_SKYATMOSPHERE_INPUT";
-	CustomInput.Input.Connect(0, SkyAtmosphere);
+	return NewObject<UMaterialExpressionSkyAtmosphereLightIlluminance>(Material);
+#else
+	return nullptr;
 #endif
 }
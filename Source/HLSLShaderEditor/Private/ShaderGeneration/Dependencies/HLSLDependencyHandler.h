@@ -2,36 +2,67 @@
 
 #include "CoreMinimal.h"
 
+class UMaterial;
+class UMaterialExpression;
+
 /// @brief	Modular element base used for adding dependency nodes to get the UE material to compile. An example of this would be
 ///			when using texture coordinates, we have to plug in a dummy TexCoord node to ensure NUM_TEX_COORD_INTERPOLATORS is set correctly by UE
+///			The tokens of all the handlers are looked for in a single pass over the shader body, and each dummy is shared by all the permutations
 struct FHLSLDependencyHandler
 {
 	virtual ~FHLSLDependencyHandler() = default;
 
-	virtual void EvaluateDependency(class UMaterial* Material, class UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const = 0;
+	// Text marking the dependency in the shader body
+	virtual const TCHAR* GetToken() const = 0;
+	// Custom node input the dummy is plugged into
+	virtual const TCHAR* GetInputName() const = 0;
+	// Called on each occurrence of the token with the text following it, gathering whatever the dummy needs into State (INDEX_NONE at first)
+	// Returns whether this occurrence needs the dummy
+	virtual bool OnTokenFound(FStringView Suffix, int32& State) const { return true; }
+	// Returns nullptr if the dummy can't be created
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const = 0;
+
+	struct FDummy
+	{
+		FName InputName;
+		UMaterialExpression* Expression = nullptr;
+	};
+	// Scans the body once for all the handlers, and creates the dummies it needs
+	static TArray<FDummy> CreateDummies(const TArray<TUniquePtr<FHLSLDependencyHandler>>& Handlers, UMaterial* Material, const FString& ShaderBody);
 };
 
 struct FHLSLDependency_TexCoords : FHLSLDependencyHandler
 {
-	virtual void EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const override;
+	virtual const TCHAR* GetToken() const override { return TEXT("Parameters.TexCoords["); }
+	virtual const TCHAR* GetInputName() const override { return TEXT("DUMMY_COORDINATE_INPUT"); }
+	virtual bool OnTokenFound(FStringView Suffix, int32& State) const override;
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const override;
 };
 
 struct FHLSLDependency_SceneTexture : FHLSLDependencyHandler
 {
-	virtual void EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const override;
+	virtual const TCHAR* GetToken() const override { return TEXT("SceneTextureLookup"); }
+	virtual const TCHAR* GetInputName() const override { return TEXT("DUMMY_SCENETEX_INPUT"); }
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const override;
 };
 
 struct FHLSLDependency_VertexColors : FHLSLDependencyHandler
 {
-	virtual void EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const override;
+	virtual const TCHAR* GetToken() const override { return TEXT("Parameters.VertexColor"); }
+	virtual const TCHAR* GetInputName() const override { return TEXT("DUMMY_COLOR_INPUT"); }
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const override;
 };
 
 struct FHLSLDependency_WPOExcludingOffsets : FHLSLDependencyHandler
 {
-	virtual void EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const override;
+	virtual const TCHAR* GetToken() const override { return TEXT("GetWorldPosition_NoMaterialOffsets"); }
+	virtual const TCHAR* GetInputName() const override { return TEXT("DUMMY_WORLD_POSITION_INPUT"); }
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const override;
 };
 
 struct FHLSLDependency_SkyAtmosphere : FHLSLDependencyHandler
 {
-	virtual void EvaluateDependency(UMaterial* Material, UMaterialExpressionCustom* HLSLNode, const FString& ShaderBody) const override;
+	virtual const TCHAR* GetToken() const override { return TEXT("MaterialExpressionSkyAtmosphere"); }
+	virtual const TCHAR* GetInputName() const override { return TEXT("DUMMY_SKYATMOSPHERE_INPUT"); }
+	virtual UMaterialExpression* CreateDummyExpression(UMaterial* Material, int32 State) const override;
 };
@@ -4,9 +4,9 @@
 #include "HLSLShader.h"
 
 #include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialSettings.h"
 #include "HLSLShaderGenerator.h"
 #include "SceneTypes.h"
-#include "Internationalization/Regex.h"
 #include "Materials/MaterialExpressionCustom.h"
 #include "Materials/MaterialExpressionFunctionInput.h"
 #include "HLSLShaderLibrary.h"
@@ -94,27 +94,109 @@ FString FHLSLShaderOutput::ParseTypeAndSemantic(FHLSLShaderOutput& Output)
 	return "";
 }
 
-FString FHLSLMaterialShader::GenerateHashedString(const FString& BaseHash) const
+FString FHLSLMaterialShader::GenerateHashedString(const FHLSLHash& BaseHash) const
 {
-	FString StringToHash =
-	BaseHash + " " +
+	FHLSLHashBuilder Builder;
+	Builder.Update(BaseHash);
+
+	// Whitespace changes don't matter
+	FHLSLWhitespaceCollapsingHasher Hasher(Builder);
 	// Changes too often
-	//FString::FromInt(StartLine) + " " +
-	InputStruct_Raw.Body + " " +
-	OutputStruct_Raw.Body + " " +
-	ReturnType + " " +
-	Name + "(" +
-	FString::Join(Arguments, TEXT(",")) + ")" +
-	Body;
+	//Hasher.Update(FString::FromInt(StartLine) + " ");
+	Hasher.Update(InputStruct_Raw.Body.GetView());
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(OutputStruct_Raw.Body.GetView());
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(ReturnType.GetView());
+	Hasher.Update(TEXT(" "));
+	Hasher.Update(Name.GetView());
+	Hasher.Update(TEXT("("));
+	for (int32 Index = 0; Index < Arguments.Num(); Index++)
+	{
+		if (Index > 0)
+		{
+			Hasher.Update(TEXT(","));
+		}
+		Hasher.Update(Arguments[Index].GetView());
+	}
+	Hasher.Update(TEXT(")"));
+	// Comments are only in the generated code if it's kept readable
+	if (GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode)
+	{
+		Hasher.Update(ProcessedBody);
+	}
+	else
+	{
+		Hasher.Update(FHLSLParser::CanonicalizeCode(ProcessedBody, false));
+	}
+	Hasher.Finish();
+
+	return "HLSL Hash: " + Builder.Finalize().ToString();
+}
 
-	StringToHash.ReplaceInline(TEXT("\t"), TEXT(" "));
-	StringToHash.ReplaceInline(TEXT("\n"), TEXT(" "));
 
-	while (StringToHash.ReplaceInline(TEXT("  "), TEXT(" "))) {}
+FArchive& operator<<(FArchive& Ar, FHLSLMaterialShader& Shader)
+{
+	Ar << static_cast<FHLSLParsedFunction&>(Shader);
+	Ar << Shader.ShaderStage;
+	Ar << Shader.Inputs;
+	Ar << Shader.Outputs;
+	Ar << Shader.InputStruct_Raw;
+	Ar << Shader.OutputStruct_Raw;
+	Ar << Shader.ProcessedBody;
+	Ar << Shader.HashedString;
+	return Ar;
+}
 
-	return "HLSL Hash: " + FHLSLMaterialUtilities::HashString(StringToHash);
+FArchive& operator<<(FArchive& Ar, FHLSLStruct& Struct)
+{
+	Ar << static_cast<FHLSLParsedStruct&>(Struct);
+	Ar << Struct.ShaderStage;
+	return Ar;
 }
 
+FArchive& operator<<(FArchive& Ar, FHLSLShaderOutput& Output)
+{
+	int32 OutputProperty = Output.OutputProperty;
+	int32 OutputType = Output.OutputType;
+
+	Ar << Output.ShaderStage;
+	Ar << Output.Type;
+	Ar << Output.Name;
+	Ar << Output.Semantic;
+	Ar << OutputProperty;
+	Ar << OutputType;
+
+	Output.OutputProperty = EMaterialProperty(OutputProperty);
+	Output.OutputType = ECustomMaterialOutputType(OutputType);
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FHLSLShaderInput& Input)
+{
+	int32 InputType = Input.InputType;
+
+	Ar << Input.ShaderStage;
+	Ar << Input.MetaStringRaw;
+	Ar << Input.Meta;
+	Ar << Input.Type;
+	Ar << Input.Name;
+	Ar << Input.DefaultValue;
+	Ar << Input.bIsConst;
+	Ar << InputType;
+	Ar << Input.bDefaultValueBool;
+	Ar << Input.DefaultValueVector;
+
+	Input.InputType = EFunctionInputType(InputType);
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FHLSLShaderInputMeta& Meta)
+{
+	Ar << Meta.Tag;
+	Ar << Meta.Parameters;
+	return Ar;
+}
 
 FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library, FHLSLShaderInput& Input)
 {
@@ -145,7 +227,7 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 		{
 			Input.InputType = FunctionInput_Scalar;
 
-			if (!Input.DefaultValue.IsEmpty() && !ParseDefaultValue(Input.DefaultValue, 1, Input.DefaultValueVector))
+			if (!Input.DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(Input.DefaultValue, 1, Input.DefaultValueVector))
 			{
 				return DefaultValueError;
 			}
@@ -154,7 +236,7 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 		{
 			Input.InputType = FunctionInput_Scalar;
 
-			if (!Input.DefaultValue.IsEmpty() && !ParseDefaultValue(Input.DefaultValue, 1, Input.DefaultValueVector))
+			if (!Input.DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(Input.DefaultValue, 1, Input.DefaultValueVector))
 			{
 				return DefaultValueError;
 			}
@@ -163,7 +245,7 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 		{
 			Input.InputType = FunctionInput_Vector2;
 
-			if (!Input.DefaultValue.IsEmpty() && !ParseDefaultValue(Input.DefaultValue, 2, Input.DefaultValueVector))
+			if (!Input.DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(Input.DefaultValue, 2, Input.DefaultValueVector))
 			{
 				return DefaultValueError;
 			}
@@ -172,7 +254,7 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 		{
 			Input.InputType = FunctionInput_Vector3;
 
-			if (!Input.DefaultValue.IsEmpty() && !ParseDefaultValue(Input.DefaultValue, 3, Input.DefaultValueVector))
+			if (!Input.DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(Input.DefaultValue, 3, Input.DefaultValueVector))
 			{
 				return DefaultValueError;
 			}
@@ -181,7 +263,7 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 		{
 			Input.InputType = FunctionInput_Vector4;
 
-			if (!Input.DefaultValue.IsEmpty() && !ParseDefaultValue(Input.DefaultValue, 4, Input.DefaultValueVector))
+			if (!Input.DefaultValue.IsEmpty() && !FHLSLParser::ParseVectorLiteral(Input.DefaultValue, 4, Input.DefaultValueVector))
 			{
 				return DefaultValueError;
 			}
@@ -241,98 +323,6 @@ FString FHLSLShaderInput::ParseMetaAndDefault(const UHLSLShaderLibrary& Library,
 	return Error;
 }
 
-bool FHLSLShaderInput::ParseDefaultValue(const FString& DefaultValue, int32 Dimension, FVector4& OutValue)
-{
-	const FString FloatPattern = R"_(\s*(-?\s*\+?\s*(?:[0-9]*[.])?[0-9]*)f?\s*)_";
-
-	const auto TryParseFloat = [&](const FString& String, auto& OutFloatValue)
-	{
-		FRegexPattern RegexPattern("^" + FloatPattern + "$");
-		FRegexMatcher RegexMatcher(RegexPattern, String);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutFloatValue = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		return true;
-	};
-
-	if (Dimension == 1)
-	{
-		return TryParseFloat(DefaultValue, OutValue.X);
-	}
-	else if (Dimension == 2)
-	{
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float2\\("+ FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
-
-		return true;
-	}
-	else if (Dimension == 3)
-	{
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float3\\("+ FloatPattern + "," + FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
-		OutValue.Z = FCString::Atof(*RegexMatcher.GetCaptureGroup(3));
-
-		return true;
-	}
-	else
-	{
-		check(Dimension == 4);
-
-		float SingleValue;
-		if (TryParseFloat(DefaultValue, SingleValue))
-		{
-			OutValue = FVector4(SingleValue);
-			return true;
-		}
-
-		FRegexPattern RegexPattern("^float4\\("+ FloatPattern + "," + FloatPattern + "," + FloatPattern + "," + FloatPattern + "\\)$");
-		FRegexMatcher RegexMatcher(RegexPattern, DefaultValue);
-		if (!RegexMatcher.FindNext())
-		{
-			return false;
-		}
-
-		OutValue.X = FCString::Atof(*RegexMatcher.GetCaptureGroup(1));
-		OutValue.Y = FCString::Atof(*RegexMatcher.GetCaptureGroup(2));
-		OutValue.Z = FCString::Atof(*RegexMatcher.GetCaptureGroup(3));
-		OutValue.W = FCString::Atof(*RegexMatcher.GetCaptureGroup(4));
-
-		return true;
-	}
-}
-
-
 FString FHLSLShaderInputMeta::GetMetaDataFromString(const UHLSLShaderLibrary& Library, FString& MetaString, EFunctionInputType InputType, TArray<FHLSLShaderInputMeta>& MetaData)
 {
 	if (MetaString.IsEmpty()) return "";
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HLSLParser.h"
 
 enum EMaterialProperty : int;
 enum EFunctionInputType : int;
@@ -11,6 +12,7 @@ class UMaterialExpression;
 class UMaterialExpressionParameter;
 class UMaterialExpressionTextureObjectParameter;
 class UMaterial;
+struct FHLSLHash;
 
 struct FHLSLShaderInputMetaParameter
 {
@@ -26,6 +28,8 @@ struct FHLSLShaderInputMeta
 
 	static FString GetMetaDataFromString(const UHLSLShaderLibrary& Library, FString& MetaString, EFunctionInputType AssociatedInput, TArray<FHLSLShaderInputMeta>& MetaData);
 	static FString VerifyMetaData(const UHLSLShaderLibrary& Library, int NumTags, EFunctionInputType AssociatedInput, const FHLSLShaderInputMeta& MetaData);
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLShaderInputMeta& Meta);
 };
 
 
@@ -48,12 +52,13 @@ struct FHLSLShaderInput
 	FVector4 DefaultValueVector{ForceInit};
 
 	static FString ParseMetaAndDefault(const UHLSLShaderLibrary& Library, FHLSLShaderInput& Input);
-	static bool ParseDefaultValue(const FString& DefaultValue, int32 Dimension, FVector4& OutValue);
 	
 	UMaterialExpression* GetInputExpression(UHLSLShaderLibrary& Library, const FGuid ParamGUID, int32 Index, const FString& BasePath) const;
 	void SetupParameterMetaTags(UMaterialExpression* Parameter) const;
 
 	UClass* GetBranchExpressionClass(bool& bRequiresBoolInput, int32& TrueIdx, int32& FalseIdx) const;
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLShaderInput& Input);
 };
 
 struct FHLSLShaderOutput
@@ -69,36 +74,37 @@ struct FHLSLShaderOutput
 	ECustomMaterialOutputType OutputType;
 
 	static FString ParseTypeAndSemantic(FHLSLShaderOutput& Output);
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLShaderOutput& Output);
 };
 
 // Container for generic structs before we process them into inputs/outputs. Could just be some code structs
-struct FHLSLStruct
+struct FHLSLStruct : FHLSLParsedStruct
 {
 	FString ShaderStage = "";
-	
-	FString Name;
-	FString Body;
+
+	friend FArchive& operator<<(FArchive& Ar, FHLSLStruct& Struct);
 };
 
-struct FHLSLMaterialShader
+struct FHLSLMaterialShader : FHLSLParsedFunction
 {
-	int32 StartLine = 0;
-
 	FString ShaderStage = "";
 
-	FString ReturnType;
-	FString Name;
-	TArray<FString> Arguments;
 	TArray<FHLSLShaderInput> Inputs; // Processed post parsing from input struct
 	TArray<FHLSLShaderOutput> Outputs; // Processed post parsing from output struct
-	FString Body;
 
 	FHLSLStruct InputStruct_Raw;
 	FHLSLStruct OutputStruct_Raw;
 
+	// Body with the explicit Input./Output. struct accesses removed. Only built once the arguments are validated
+	FString ProcessedBody;
+
 	FString HashedString;
 
-	FString GenerateHashedString(const FString& BaseHash) const;
+	FString GenerateHashedString(const FHLSLHash& BaseHash) const;
+
+	// Everything needed to generate the material, for the IR cache
+	friend FArchive& operator<<(FArchive& Ar, FHLSLMaterialShader& Shader);
 
 	// Definitions
 	inline static FString VERTEX_SHADER = "vert";
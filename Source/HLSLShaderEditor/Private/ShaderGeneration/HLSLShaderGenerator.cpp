@@ -7,14 +7,18 @@
 #include "HLSLShader.h"
 #include "HLSLShaderLibrary.h"
 #include "HLSLMaterialEditor/Private/HLSLMaterialErrorHook.h"
+#include "HLSLMaterialSettings.h"
+#include "HLSLParser.h"
 #include "IMaterialEditor.h"
 #include "MaterialEditorActions.h"
 #include "Framework/Notifications/NotificationManager.h"
 #include "Internationalization/Regex.h"
 #include "Materials/Material.h"
 #include "Materials/MaterialExpressionComment.h"
+#include "Materials/MaterialExpressionConstant.h"
 #include "Materials/MaterialExpressionCustom.h"
 #include "Materials/MaterialExpressionFunctionInput.h"
+#include "Materials/MaterialExpressionGetMaterialAttributes.h"
 #include "Materials/MaterialExpressionParameter.h"
 #include "Materials/MaterialExpressionPreviousFrameSwitch.h"
 #include "Materials/MaterialExpressionStaticSwitch.h"
@@ -26,6 +30,7 @@
 #include "MaterialEditor.h"
 #include "Dependencies/HLSLDependencyHandler.h"
 #include "Materials/MaterialExpressionSceneTexture.h"
+#include "Materials/MaterialExpressionSetMaterialAttributes.h"
 #include "Materials/MaterialExpressionSkyAtmosphereLightIlluminance.h"
 #include "MetaTags/HLSLUniqueParameterMetaTags.h"
 
@@ -34,9 +39,12 @@ TMap<FString, TUniquePtr<FHLSLMetaTagHandler>> FHLSLShaderGenerator::MetaTagStru
 TMap<FString, TUniquePtr<FHLSLUniqueMetaTagHandler>> FHLSLShaderGenerator::UniqueMetaTagStructMap;
 TArray<TUniquePtr<FHLSLDependencyHandler>> FHLSLShaderGenerator::DependencyHandlers;
 
-FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const TArray<FString>& IncludeFilePaths,
-                                             FHLSLMaterialShader Shader, const TMap<FName, FGuid>& ParameterGuids)
+FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const TArray<FString>& IncludeFilePaths, const FString& IncludesDigest,
+                                             const FHLSLMaterialShader& Shader, const THLSLTempMap<FName, FGuid>& ParameterGuids)
 {
+	// Everything below only lives until the end of the generation
+	FMemMark MemMark(FMemStack::Get());
+
 	///////////////////////////////////////////////////////////////////////////////////
 	//// Past this point, try to never error out as it'll break existing functions ////
 	///////////////////////////////////////////////////////////////////////////////////
@@ -50,17 +58,34 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 
 #pragma region Create Input Parameters Expressions
 	// Keep track of indices to Static Bools since we'll be generating permutations and connecting them through static switches
-	TArray<int32> StaticBoolParameters;
-	for (int32 Index = 0; Index < Shader.Inputs.Num(); Index++)
+	THLSLTempArray<int32> StaticBoolParameters;
+	// Static bools the body never reads: each one would double the graph for nothing. They keep their parameter, and their default value in the code
+	THLSLTempArray<int32> UnusedStaticBools;
 	{
-		if (Shader.Inputs[Index].InputType == FunctionInput_StaticBool)
+		// Mentions in comments don't count
+		const FString Code = FHLSLParser::CanonicalizeCode(Shader.ProcessedBody, false);
+		for (int32 Index = 0; Index < Shader.Inputs.Num(); Index++)
 		{
-			StaticBoolParameters.Add(Index);
+			const FHLSLShaderInput& Input = Shader.Inputs[Index];
+			if (Input.InputType != FunctionInput_StaticBool)
+			{
+				continue;
+			}
+
+			if (FHLSLParser::ContainsIdentifier(Code, Input.Name))
+			{
+				StaticBoolParameters.Add(Index);
+			}
+			else
+			{
+				UE_LOG(LogHLSLMaterial, Verbose, TEXT("%s: static bool %s is never read, skipping its permutations"), *Shader.Name.ToString(), *Input.Name);
+				UnusedStaticBools.Add(Index);
+			}
 		}
 	}
 
 	// Create input Parameter material expressions and store them in an array which we'll connect later
-	TArray<UMaterialExpression*> ShaderInputs;
+	THLSLTempArray<UMaterialExpression*> ShaderInputs;
 	//GenerateShaderParameterExpressions(Shader, ShaderInputs);
 	for (int32 Index = 0; Index < Shader.Inputs.Num(); Index++)
 	{
@@ -70,8 +95,122 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 	}
 #pragma endregion
 
+#pragma region Fold Static Bools
+	// Instead of a custom node per permutation, pass the static bools to a single one as constants
+	// The switch picks the constant when compiling each permutation, and the shader compiler folds the branches on it
+	const bool bFoldStaticBools = Library.bFoldStaticBools && StaticBoolParameters.Num() > 0;
+
+	THLSLTempArray<UMaterialExpression*> CustomNodeInputs = ShaderInputs;
+	if (bFoldStaticBools)
+	{
+		const auto CreateConstant = [&](const float Value, const int32 EditorY)
+		{
+			UMaterialExpressionConstant* Constant = NewObject<UMaterialExpressionConstant>(Library.Materials.Get());
+			Constant->MaterialExpressionGuid = FGuid::NewGuid();
+			Constant->MaterialExpressionEditorX = -500;
+			Constant->MaterialExpressionEditorY = EditorY;
+			Constant->R = Value;
+			Library.Materials->FunctionExpressions.Add(Constant);
+			return Constant;
+		};
+		UMaterialExpressionConstant* TrueConstant = CreateConstant(1.f, -200);
+		UMaterialExpressionConstant* FalseConstant = CreateConstant(0.f, -100);
+
+		for (int32 Index = 0; Index < StaticBoolParameters.Num(); Index++)
+		{
+			const int32 InputIndex = StaticBoolParameters[Index];
+
+			bool bRequiresBoolInput = true; int32 TrueIdx = 0, FalseIdx = 1;
+			UClass* Class = Shader.Inputs[InputIndex].GetBranchExpressionClass(bRequiresBoolInput, TrueIdx, FalseIdx);
+
+			UMaterialExpression* StaticSwitch = NewObject<UMaterialExpression>(Library.Materials.Get(), Class);
+			StaticSwitch->MaterialExpressionGuid = FGuid::NewGuid();
+			StaticSwitch->MaterialExpressionEditorX = 0;
+			StaticSwitch->MaterialExpressionEditorY = 200 * Index;
+			Library.Materials->FunctionExpressions.Add(StaticSwitch);
+
+			StaticSwitch->GetInput(TrueIdx)->Connect(0, TrueConstant);
+			StaticSwitch->GetInput(FalseIdx)->Connect(0, FalseConstant);
+
+			if (bRequiresBoolInput)
+				StaticSwitch->GetInput(2)->Connect(0, ShaderInputs[InputIndex]);
+
+			CustomNodeInputs[InputIndex] = StaticSwitch;
+		}
+
+		// Nothing left to permute
+		StaticBoolParameters.Reset();
+	}
+#pragma endregion
+
+#pragma region Permutation Constraints
+	// Requires/Excludes/OneOf tags on the static bools, as masks of the permutation bits
+	// Bits are only set for bools we permute: folded or unused bools don't prune anything, see FHLSLShaderParser::WarnIgnoredConstraints
+	THLSLTempArray<uint32> RequiredMasks;
+	THLSLTempArray<uint32> ExcludedMasks;
+	THLSLTempMap<FString, uint32> OneOfMasks;
+	{
+		const auto GetBit = [&](const FString& Name) -> uint32
+		{
+			const int32 Layer = StaticBoolParameters.IndexOfByPredicate([&](const int32 InputIndex) { return Shader.Inputs[InputIndex].Name == Name; });
+			return Layer == INDEX_NONE ? 0 : 1u << Layer;
+		};
+
+		for (int32 Layer = 0; Layer < StaticBoolParameters.Num(); Layer++)
+		{
+			uint32& RequiredMask = RequiredMasks.Add_GetRef(0);
+			uint32& ExcludedMask = ExcludedMasks.Add_GetRef(0);
+
+			for (const FHLSLShaderInputMeta& Meta : Shader.Inputs[StaticBoolParameters[Layer]].Meta)
+			{
+				const FString Tag = Meta.Tag.ToLower();
+				const FString Parameter = Meta.Parameters[0].TrimStartAndEnd();
+				if (Tag == "requires")
+				{
+					RequiredMask |= GetBit(Parameter);
+				}
+				else if (Tag == "excludes")
+				{
+					ExcludedMask |= GetBit(Parameter);
+				}
+				else if (Tag == "oneof")
+				{
+					// At most one true, they can all be false
+					OneOfMasks.FindOrAdd(Parameter) |= 1u << Layer;
+				}
+			}
+		}
+	}
+
+	// Bit Index of Width set means StaticBoolParameters[Index] is false, see below
+	const auto IsLegalPermutation = [&](const int32 Width)
+	{
+		const uint32 TrueMask = ~uint32(Width) & ((1u << StaticBoolParameters.Num()) - 1);
+		for (int32 Layer = 0; Layer < StaticBoolParameters.Num(); Layer++)
+		{
+			if (!(TrueMask & (1u << Layer)))
+			{
+				continue;
+			}
+			if ((TrueMask & RequiredMasks[Layer]) != RequiredMasks[Layer] ||
+				(TrueMask & ExcludedMasks[Layer]) != 0)
+			{
+				return false;
+			}
+		}
+		for (const auto& It : OneOfMasks)
+		{
+			if (FMath::CountBits(TrueMask & It.Value) > 1)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+#pragma endregion
+
 #pragma region Create Output Identifiers
-	TArray<EMaterialProperty> OutputProperties;
+	THLSLTempArray<EMaterialProperty> OutputProperties;
 	for (const auto& Output : Shader.Outputs)
 	{
 		OutputProperties.Add(Output.OutputProperty);
@@ -88,11 +227,58 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 	};
 
 	// Create the necessary expressions based on the static switches
-	TArray<TArray<FOutputPin>> AllOutputPins;
-	
+	THLSLTempArray<THLSLTempArray<FOutputPin>> AllOutputPins;
+
+	// Pack the outputs of each permutation in a single pin, so that each static bool only needs one switch per pair of permutations
+	const bool bSwitchMaterialAttributes =
+		Library.bSwitchMaterialAttributes &&
+		StaticBoolParameters.Num() > 0 &&
+		Shader.Outputs.Num() > 1;
+
+	// Shared by all the permutations the constraints rule out, so that they cost a single node
+	// Instances can still select them through the switches, and get default outputs
+	FOutputPin FallbackPin;
+	const auto GetFallbackPin = [&]
+	{
+		if (!FallbackPin.Expression)
+		{
+			if (bSwitchMaterialAttributes)
+			{
+				// Nothing set, the default attributes
+				FallbackPin.Expression = NewObject<UMaterialExpressionSetMaterialAttributes>(Library.Materials.Get());
+			}
+			else
+			{
+				UMaterialExpressionConstant* Constant = NewObject<UMaterialExpressionConstant>(Library.Materials.Get());
+				Constant->R = 0.f;
+				FallbackPin.Expression = Constant;
+			}
+			FallbackPin.Expression->MaterialExpressionGuid = FGuid::NewGuid();
+			FallbackPin.Expression->MaterialExpressionEditorX = 500;
+			FallbackPin.Expression->MaterialExpressionEditorY = -100;
+			Library.Materials->FunctionExpressions.Add(FallbackPin.Expression);
+		}
+		return FallbackPin;
+	};
+
+	// The body is the same for all the permutations, so are its dependencies
+	const TArray<FHLSLDependencyHandler::FDummy> DependencyDummies = FHLSLDependencyHandler::CreateDummies(DependencyHandlers, Library.Materials.Get(), Shader.ProcessedBody);
+
+	// Reset for each permutation, keeping its allocation
+	FString LocalVariableDeclarations;
 	for (int32 Width = 0; Width < 1 << StaticBoolParameters.Num(); Width++)
 	{
-		FString LocalVariableDeclarations = "";
+		if (!IsLegalPermutation(Width))
+		{
+			THLSLTempArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
+			for (int32 Index = 0; Index < (bSwitchMaterialAttributes ? 1 : Shader.Outputs.Num()); Index++)
+			{
+				OutputPins.Add(GetFallbackPin());
+			}
+			continue;
+		}
+
+		LocalVariableDeclarations.Reset();
 		for (int32 Index = 0; Index < StaticBoolParameters.Num(); Index++)
 		{
 			// Each permutation covers a seperate value of the bools
@@ -101,6 +287,11 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 			bValue = !bValue;
 			LocalVariableDeclarations += "const bool INTERNAL_IN_" + Shader.Inputs[StaticBoolParameters[Index]].Name + " = " + (bValue ? "true" : "false") + ";\n";
 		}
+		for (const int32 InputIndex : UnusedStaticBools)
+		{
+			const FHLSLShaderInput& Input = Shader.Inputs[InputIndex];
+			LocalVariableDeclarations += "const bool INTERNAL_IN_" + Input.Name + " = " + (Input.bDefaultValueBool ? "true" : "false") + ";\n";
+		}
 
 		// Add other inputs
 		for (const FHLSLShaderInput& Input : Shader.Inputs)
@@ -144,7 +335,7 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 		MaterialExpressionCustom->MaterialExpressionGuid = FGuid::NewGuid();
 		MaterialExpressionCustom->bCollapsed = true;
 		MaterialExpressionCustom->OutputType = Shader.ShaderStage == FHLSLMaterialShader::PIXEL_SHADER ? CMOT_Float1 : CMOT_Float3;
-		MaterialExpressionCustom->Code = GenerateFunctionCode(Library, Shader, LocalVariableDeclarations);
+		MaterialExpressionCustom->Code = GenerateFunctionCode(Library, IncludesDigest, Shader, LocalVariableDeclarations);
 		MaterialExpressionCustom->MaterialExpressionEditorX = 500;
 		MaterialExpressionCustom->MaterialExpressionEditorY = 200 * Width;
 		MaterialExpressionCustom->IncludeFilePaths = IncludeFilePaths;
@@ -154,15 +345,15 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 		MaterialExpressionCustom->Inputs.Reset();
 		for (int32 Index = 0; Index < Shader.Inputs.Num(); Index++)
 		{
-			FHLSLShaderInput& Input = Shader.Inputs[Index];
-			if (Input.InputType == FunctionInput_StaticBool)
+			const FHLSLShaderInput& Input = Shader.Inputs[Index];
+			if (Input.InputType == FunctionInput_StaticBool && (!bFoldStaticBools || UnusedStaticBools.Contains(Index)))
 			{
 				continue;
 			}
 
 			FCustomInput& CustomInput = MaterialExpressionCustom->Inputs.Emplace_GetRef();
 			CustomInput.InputName = *("INTERNAL_IN_" + Input.Name);
-			CustomInput.Input.Connect(0, ShaderInputs[Index]);
+			CustomInput.Input.Connect(0, CustomNodeInputs[Index]);
 		}
 		
 		// Add outputs to HLSL node (we'll connect them to the final material attributes later, indices indicate where)
@@ -175,23 +366,42 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 			}
 		}
 		
-		// Create the dummies necessary for certain things to compile for UE 
+		// Plug in the dummies necessary for certain things to compile for UE
+		for (const FHLSLDependencyHandler::FDummy& Dummy : DependencyDummies)
 		{
-			for (auto const& dep : DependencyHandlers)
-			{
-				dep->EvaluateDependency(Library.Materials.Get(), MaterialExpressionCustom, Shader.Body);
-			}
+			FCustomInput& CustomInput = MaterialExpressionCustom->Inputs.Emplace_GetRef();
+			CustomInput.InputName = Dummy.InputName;
+			CustomInput.Input.Connect(0, Dummy.Expression);
 		}
 
 		MaterialExpressionCustom->PostEditChange();
 
-		TArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
+		THLSLTempArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
 		for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
 		{
 			// +1 as default output pin is result in HLSL node
 			const int OutputOffset = Shader.ShaderStage == FHLSLMaterialShader::PIXEL_SHADER ? 1 : 0;
 			OutputPins.Add({MaterialExpressionCustom, Index + OutputOffset});
 		}
+
+		if (bSwitchMaterialAttributes)
+		{
+			UMaterialExpressionSetMaterialAttributes* SetAttributes = NewObject<UMaterialExpressionSetMaterialAttributes>(Library.Materials.Get());
+			SetAttributes->MaterialExpressionGuid = FGuid::NewGuid();
+			SetAttributes->MaterialExpressionEditorX = 1000;
+			SetAttributes->MaterialExpressionEditorY = 200 * Width;
+			Library.Materials->FunctionExpressions.Add(SetAttributes);
+
+			// First input is the attributes to override, left empty
+			for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
+			{
+				SetAttributes->AttributeSetTypes.Add(FMaterialAttributeDefinitionMap::GetID(Shader.Outputs[Index].OutputProperty));
+				SetAttributes->Inputs.Emplace_GetRef().Connect(OutputPins[Index].Index, OutputPins[Index].Expression);
+			}
+
+			OutputPins.Reset();
+			OutputPins.Add({ SetAttributes, 0 });
+		}
 	}
 #pragma endregion
 
@@ -203,25 +413,34 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 		const int32 InputIndex = StaticBoolParameters[Layer];
 		const FHLSLShaderInput& Input = Shader.Inputs[InputIndex];
 
-		const TArray<TArray<FOutputPin>> PreviousAllOutputPins = MoveTemp(AllOutputPins);
+		// Mem stack arrays can't be moved, MoveTemp would copy and leave AllOutputPins as is
+		const THLSLTempArray<THLSLTempArray<FOutputPin>> PreviousAllOutputPins = AllOutputPins;
+		AllOutputPins.Reset();
 
 		for (int32 Width = 0; Width < 1 << (StaticBoolParameters.Num() - Layer - 1); Width++)
 		{
-			TArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
-			for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
+			THLSLTempArray<FOutputPin>& OutputPins = AllOutputPins.Emplace_GetRef();
+			for (int32 Index = 0; Index < PreviousAllOutputPins[2 * Width].Num(); Index++)
 			{
+				const FOutputPin& OutputPinA = PreviousAllOutputPins[2 * Width + 0][Index];
+				const FOutputPin& OutputPinB = PreviousAllOutputPins[2 * Width + 1][Index];
+
+				// Both sides ruled out by the constraints, no need to switch
+				if (OutputPinA.Expression == OutputPinB.Expression && OutputPinA.Index == OutputPinB.Index)
+				{
+					OutputPins.Add(OutputPinA);
+					continue;
+				}
+
 				bool bRequiresBoolInput = true; int32 TrueIdx = 0, FalseIdx = 1; // e.g ShadowPass the order is flipped where True is the second input
 				UClass* Class = Input.GetBranchExpressionClass(bRequiresBoolInput, TrueIdx, FalseIdx);
 
 				UMaterialExpression* StaticSwitch = NewObject<UMaterialExpression>(Library.Materials.Get(), Class);
 				StaticSwitch->MaterialExpressionGuid = FGuid::NewGuid();
-				StaticSwitch->MaterialExpressionEditorX = (Layer + 2) * 500;
+				StaticSwitch->MaterialExpressionEditorX = (Layer + (bSwitchMaterialAttributes ? 3 : 2)) * 500;
 				StaticSwitch->MaterialExpressionEditorY = 200 * Width;
 				Library.Materials->FunctionExpressions.Add(StaticSwitch);
 
-				const FOutputPin& OutputPinA = PreviousAllOutputPins[2 * Width + 0][Index];
-				const FOutputPin& OutputPinB = PreviousAllOutputPins[2 * Width + 1][Index];
-
 				StaticSwitch->GetInput(TrueIdx)->Connect(OutputPinA.Index, OutputPinA.Expression);
 				StaticSwitch->GetInput(FalseIdx)->Connect(OutputPinB.Index, OutputPinB.Expression);
 
@@ -238,10 +457,36 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 #pragma region Connect To Output/Material Attributes
 	// Start connecting outputs to material attributes
 	ensure(AllOutputPins.Num() == 1);
-	for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
+	if (bSwitchMaterialAttributes)
+	{
+		// Break the switched attributes back out to the material pins
+		UMaterialExpressionGetMaterialAttributes* GetAttributes = NewObject<UMaterialExpressionGetMaterialAttributes>(Library.Materials.Get());
+		GetAttributes->MaterialExpressionGuid = FGuid::NewGuid();
+		GetAttributes->MaterialExpressionEditorX = (StaticBoolParameters.Num() + 3) * 500;
+		GetAttributes->MaterialExpressionEditorY = 0;
+		for (const FHLSLShaderOutput& Output : Shader.Outputs)
+		{
+			GetAttributes->AttributeGetTypes.Add(FMaterialAttributeDefinitionMap::GetID(Output.OutputProperty));
+		}
+		// Creates an output per attribute, after the attributes themselves
+		GetAttributes->PostEditChange();
+		Library.Materials->FunctionExpressions.Add(GetAttributes);
+
+		const FOutputPin& Pin = AllOutputPins[0][0];
+		GetAttributes->MaterialAttributes.Connect(Pin.Index, Pin.Expression);
+
+		for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
+		{
+			Library.Materials->GetExpressionInputForProperty(Shader.Outputs[Index].OutputProperty)->Connect(Index + 1, GetAttributes);
+		}
+	}
+	else
 	{
-		const FOutputPin& Pin = AllOutputPins[0][Index];
-		Library.Materials->GetExpressionInputForProperty(Shader.Outputs[Index].OutputProperty)->Connect(Pin.Index, Pin.Expression);
+		for (int32 Index = 0; Index < Shader.Outputs.Num(); Index++)
+		{
+			const FOutputPin& Pin = AllOutputPins[0][Index];
+			Library.Materials->GetExpressionInputForProperty(Shader.Outputs[Index].OutputProperty)->Connect(Pin.Index, Pin.Expression);
+		}
 	}
 #pragma endregion
 
@@ -261,29 +506,42 @@ FString FHLSLShaderGenerator::GenerateShader(UHLSLShaderLibrary& Library, const
 	return "";
 }
 
-FString FHLSLShaderGenerator::GenerateFunctionCode(const UHLSLShaderLibrary& Library, const FHLSLMaterialShader& Shader, const FString& Declarations)
+FString FHLSLShaderGenerator::GenerateFunctionCode(const UHLSLShaderLibrary& Library, const FString& IncludesDigest, const FHLSLMaterialShader& Shader, const FString& Declarations)
 {
 	FString Code;
 
 	// In the pixel shader, replace any instances of return; with return 0.f; to make the custom HLSL expression happy (it requires an actual return value)
 	if (Shader.ShaderStage == FHLSLMaterialShader::PIXEL_SHADER)
-		Code += Shader.Body.Replace(TEXT("return"), TEXT("return 0.f"));
-	else Code += Shader.Body;
+		Code += Shader.ProcessedBody.Replace(TEXT("return"), TEXT("return 0.f"));
+	else Code += Shader.ProcessedBody;
 	
 	if (Library.bAccurateErrors)
 	{
+		// Lines relative to the shader: the code doesn't change when lines are added above it
 		Code = FString::Printf(TEXT(
-			"#line %d \"%s%s%s\"\n%s\n#line 10000 \"Error occured outside of Custom HLSL node, line number will be inaccurate. "
+			"%s\n%s\n#line 10000 \"Error occured outside of Custom HLSL node, line number will be inaccurate. "
 			"Untick bAccurateErrors on your HLSL library to fix this (%s)\""),
-			Shader.StartLine + 1,
-			FHLSLMaterialErrorHook::PathPrefix,
-			*Library.File.FilePath,
-			FHLSLMaterialErrorHook::PathSuffix,
+			*FHLSLMaterialErrorHook::GetLineDirective(Library.File.FilePath, Shader.Name.ToString()),
 			*Code,
 			*Library.GetPathName());
 	}
 
-	return FString::Printf(TEXT("// START %s\n\n%s\n%s\n\n// END %s\n\nreturn 0.f;\n//%s\n"), *Shader.Name, *Declarations, *Code, *Shader.Name, *Shader.HashedString);
+	if (GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode)
+	{
+		const FString ShaderName = Shader.Name.ToString();
+		return FString::Printf(TEXT("// START %s\n\n%s\n%s\n\n// END %s\n\nreturn 0.f;\n//%s\n"), *ShaderName, *Declarations, *Code, *ShaderName, *Shader.HashedString);
+	}
+
+	// Only what the compiler sees, so that comment & formatting edits reuse the compiled shaders
+	// The nodes of the shader stage carrying the includes also carry their digest, so that the code still changes when they do
+	FString Result = FString::Printf(TEXT("%s\n%s\nreturn 0.f;\n"),
+		*FHLSLParser::CanonicalizeCode(Declarations, false),
+		*FHLSLParser::CanonicalizeCode(Code, Library.bAccurateErrors));
+	if (!IncludesDigest.IsEmpty())
+	{
+		Result += "//" + IncludesDigest + "\n";
+	}
+	return Result;
 }
 
 IMaterialEditor* FHLSLShaderGenerator::FindMaterialEditorForAsset(UObject* InAsset)
@@ -315,6 +573,10 @@ void FHLSLShaderGenerator::Initialize()
 	MetaTagStructMap.Add("primitivedata", MetaTag(FHLSLMetaTag_PrimitiveData));
 	MetaTagStructMap.Add("range", MetaTag(FHLSLMetaTag_Range));
 	MetaTagStructMap.Add("samplertype", MetaTag(FHLSLMetaTag_SamplerType));
+	// Constraints between bool inputs, pruning the permutations
+	MetaTagStructMap.Add("requires", MetaTag(FHLSLMetaTag_Requires));
+	MetaTagStructMap.Add("excludes", MetaTag(FHLSLMetaTag_Excludes));
+	MetaTagStructMap.Add("oneof", MetaTag(FHLSLMetaTag_OneOf));
 
 	UniqueMetaTagStructMap.Empty();
 	// Special inputs w/ unique expressions
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialEditor/Private/HLSLMaterialTempContainers.h"
 
 class UHLSLShaderLibrary;
 class UMaterialExpressionParameter;
@@ -17,10 +19,11 @@ public:
 	static FString GenerateShader(
 		UHLSLShaderLibrary& Library,
 		const TArray<FString>& IncludeFilePaths,
-		FHLSLMaterialShader Shader,
-		const TMap<FName, FGuid>& ParameterGuids);
+		const FString& IncludesDigest,
+		const FHLSLMaterialShader& Shader,
+		const THLSLTempMap<FName, FGuid>& ParameterGuids);
 
-	static FString GenerateFunctionCode(const UHLSLShaderLibrary& Library, const FHLSLMaterialShader& Function, const FString& Declarations);
+	static FString GenerateFunctionCode(const UHLSLShaderLibrary& Library, const FString& IncludesDigest, const FHLSLMaterialShader& Function, const FString& Declarations);
 	static IMaterialEditor* FindMaterialEditorForAsset(UObject* InAsset);
 
 	// All the modular pieces for generating materials
@@ -7,9 +7,14 @@
 #include "HLSLShaderGenerator.h"
 #include "HLSLShaderParser.h"
 #include "HLSLMaterialUtilities.h"
+#include "HLSLMaterialEditor/Private/HLSLMaterialErrorHook.h"
 #include "HLSLMaterialEditor/Private/HLSLMaterialFileWatcher.h"
+#include "HLSLMaterialEditor/Private/HLSLMaterialIncludeCache.h"
+#include "HLSLMaterialEditor/Private/HLSLMaterialIRCache.h"
+#include "HLSLMaterialEditor/Private/HLSLMaterialPackageStamp.h"
 #include "HLSLShaderMessages.h"
 #include "HLSLShaderLibrary.h"
+#include "HLSLMaterialSettings.h"
 #include "IMaterialEditor.h"
 #include "MaterialEditingLibrary.h"
 #include "MaterialEditorActions.h"
@@ -18,6 +23,7 @@
 #include "ScopedTransaction.h"
 
 #include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
 #include "AssetRegistry/AssetData.h"
 #include "Materials/MaterialFunction.h"
 #include "AssetRegistry/AssetRegistryModule.h"
@@ -88,13 +94,17 @@ TSharedRef<FVirtualDestructor> FHLSLShaderLibraryEditor::CreateWatcher(UHLSLShad
 		FString Text;
 		if (TryLoadFileToString(Text, Library.GetFilePath()))
 		{
+			TArray<FString> VirtualPaths;
 			for (const FHLSLShaderParser::FInclude& Include : FHLSLShaderParser::GetIncludes(FullPath, Text))
 			{
+				VirtualPaths.Add(Include.VirtualPath);
+
 				if (!Include.DiskPath.IsEmpty())
 				{
 					Files.Add(Include.DiskPath);
 				}
 			}
+			Files.Append(FHLSLMaterialIncludeCache::GetNestedIncludes(VirtualPaths));
 		}
 	}
 
@@ -108,10 +118,40 @@ TSharedRef<FVirtualDestructor> FHLSLShaderLibraryEditor::CreateWatcher(UHLSLShad
 	return Watcher;
 }
 
+namespace
+{
+	// Same as ParseIntoArrayWS, without copying the words
+	void SplitWhitespace(const FStringView Text, THLSLTempArray<FStringView>& OutWords)
+	{
+		int32 Index = 0;
+		while (Index < Text.Len())
+		{
+			while (Index < Text.Len() && FChar::IsWhitespace(Text[Index]))
+			{
+				Index++;
+			}
+
+			const int32 WordStart = Index;
+			while (Index < Text.Len() && !FChar::IsWhitespace(Text[Index]))
+			{
+				Index++;
+			}
+
+			if (Index > WordStart)
+			{
+				OutWords.Add(Text.Mid(WordStart, Index - WordStart));
+			}
+		}
+	}
+}
+
 void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 {
 	FHLSLShaderMessages::FLibraryScope Scope(Library);
 
+	// The temporaries of this generation are all freed at once when we return
+	FMemMark MemMark(FMemStack::Get());
+
 	// Always recreate watcher in case includes changed
 	Library.CreateWatcherIfNeeded();
 
@@ -125,50 +165,111 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		return;
 	}
 
+	const FHLSLShaderParser::FDirectives Directives = FHLSLShaderParser::GetDirectives(FullPath, Text);
+
+	FHLSLHashBuilder SourceHashBuilder;
+	SourceHashBuilder.Update(Text);
+	SourceHashBuilder.Update(&Library.bAccurateErrors, sizeof(bool));
+
+	FHLSLHashBuilder BaseHashBuilder;
+	{
+		// Changes the code of every shader
+		const bool bReadableGeneratedCode = GetDefault<UHLSLMaterialSettings>()->bReadableGeneratedCode;
+		BaseHashBuilder.Update(&bReadableGeneratedCode, sizeof(bool));
+		SourceHashBuilder.Update(&bReadableGeneratedCode, sizeof(bool));
+	}
+	// Change the graph of every shader
+	BaseHashBuilder.Update(&Library.bSwitchMaterialAttributes, sizeof(bool));
+	BaseHashBuilder.Update(&Library.bFoldStaticBools, sizeof(bool));
+	SourceHashBuilder.Update(&Library.bSwitchMaterialAttributes, sizeof(bool));
+	SourceHashBuilder.Update(&Library.bFoldStaticBools, sizeof(bool));
+
 	// Collect and validate all the #include "..."
-	FString BaseHash;
 	TArray<FString> IncludeFilePaths;
-	for (const FHLSLShaderParser::FInclude& Include : FHLSLShaderParser::GetIncludes(FullPath, Text))
+	bool bHasInvalidIncludes = false;
+	// Of all the included files, computed once for all the custom nodes
+	FHLSLHashBuilder IncludesDigestBuilder;
+	for (const FHLSLShaderParser::FInclude& Include : Directives.Includes)
 	{
 		IncludeFilePaths.Add(Include.VirtualPath);
 
-		FString IncludeText;
-		if (TryLoadFileToString(IncludeText, Include.DiskPath))
+		FHLSLHash IncludeHash;
+		if (FHLSLMaterialIncludeCache::GetHash(Include.DiskPath, IncludeHash))
 		{
-			BaseHash += FHLSLMaterialUtilities::HashString(IncludeText);
+			BaseHashBuilder.Update(IncludeHash);
+			SourceHashBuilder.Update(IncludeHash);
+			IncludesDigestBuilder.Update(IncludeHash);
 		}
 		else
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Invalid include: %s"), *Include.VirtualPath);
+			FHLSLShaderMessages::ShowError(TEXT("Invalid include: %s (line %d)"), *Include.VirtualPath, Include.Line);
+			bHasInvalidIncludes = true;
+		}
+	}
+	for (const FString& DiskPath : FHLSLMaterialIncludeCache::GetNestedIncludes(IncludeFilePaths))
+	{
+		FHLSLHash IncludeHash;
+		if (FHLSLMaterialIncludeCache::GetHash(DiskPath, IncludeHash))
+		{
+			BaseHashBuilder.Update(IncludeHash);
+			SourceHashBuilder.Update(IncludeHash);
+			IncludesDigestBuilder.Update(IncludeHash);
+		}
+	}
+	const FString IncludesDigest = IncludeFilePaths.Num() > 0 ? IncludesDigestBuilder.Finalize().ToString() : FString();
+
+	// Exact same bytes as the last time the material was up to date, and the material wasn't touched since
+	const FHLSLHash SourceHash = SourceHashBuilder.Finalize();
+	const FString SourceFingerprint = SourceHash.ToString();
+	if (!bHasInvalidIncludes &&
+		Library.SourceFingerprint == SourceFingerprint &&
+		!Library.Materials.IsNull() &&
+		!Library.GeneratedPackageStamp.IsEmpty() &&
+		Library.GeneratedPackageStamp == FHLSLMaterialPackageStamp::Get({ Library.Materials.GetLongPackageName() }))
+	{
+		UE_LOG(LogHLSLMaterial, Verbose, TEXT("%s already up to date"), *Library.GetName());
+		return;
+	}
+
+	// Bump when the shaders or their serialization change
+	constexpr int32 IRCacheVersion = 2;
+
+	// Source unchanged since a previous session: shaders are loaded already validated, with their hash
+	{
+		TArray<FHLSLMaterialShader> CachedShaders;
+		if (FHLSLMaterialIRCache::Load(Library, IRCacheVersion, SourceHash, [&](FArchive& Ar) { Ar << CachedShaders; }))
+		{
+			UpdateMaterial(Library, IncludeFilePaths, IncludesDigest, Directives.Settings, CachedShaders, SourceFingerprint, bHasInvalidIncludes);
+			return;
 		}
 	}
 
 	// Collect and validate all the #define SETTING VALUE
-	TArray<FHLSLShaderParser::FSetting> Settings = FHLSLShaderParser::GetSettings(Text); 
+	const TArray<FHLSLShaderParser::FSetting>& Settings = Directives.Settings;
 	for (const FHLSLShaderParser::FSetting& Setting : Settings)
 	{
-		BaseHash += FHLSLMaterialUtilities::HashString(Setting.Setting);
-		BaseHash += FHLSLMaterialUtilities::HashString(Setting.Value);
+		BaseHashBuilder.Update(Setting.Setting);
+		BaseHashBuilder.Update(Setting.Value);
 	}
 
 	// Collect and validate all the #pragma type name (functions & input/output structs declarations)
 	TArray<FHLSLShaderParser::FPragmaDeclarations> PragmaDeclarations;
 	TArray<FString> EncounteredPragmaTokens;
-	for (const FHLSLShaderParser::FPragmaDeclarations& NameDefs : FHLSLShaderParser::GetPragmaDeclarations(Text))
+	for (const FHLSLShaderParser::FPragmaDeclarations& NameDefs : Directives.PragmaDeclarations)
 	{
 		if (EncounteredPragmaTokens.Contains(NameDefs.Type))
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Encountered multiple Tokens: %s"), *NameDefs.Type);
+			FHLSLShaderMessages::ShowError(TEXT("Encountered multiple Tokens: %s (line %d)"), *NameDefs.Type, NameDefs.Line);
 			return;
 		}
 		else if (FHLSLMaterialShader::PRAGMA_DEFS.Contains(NameDefs.Type))
 		{
-			BaseHash += FHLSLMaterialUtilities::HashString(NameDefs.Type);
-			BaseHash += FHLSLMaterialUtilities::HashString(NameDefs.Name);
+			BaseHashBuilder.Update(NameDefs.Type);
+			BaseHashBuilder.Update(NameDefs.Name);
 		}
 		else
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Invalid Function/Struct Token: %s %s"), *NameDefs.Type, *NameDefs.Name);
+			FHLSLShaderMessages::ShowError(TEXT("Invalid Function/Struct Token: %s %s (line %d)"), *NameDefs.Type, *NameDefs.Name, NameDefs.Line);
 			return;
 		}
 
@@ -181,7 +282,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 	TArray<FHLSLMaterialShader> Shaders;
 	TArray<FHLSLStruct> Structs;
 	{
-		const FString Error = FHLSLShaderParser::Parse(Library, Text, Shaders, Structs);
+		const FString Error = FHLSLShaderParser::Parse(Library, MoveTemp(Text), Shaders, Structs);
 		if (!Error.IsEmpty())
 		{
 			FHLSLShaderMessages::ShowError(TEXT("Parsing failed: %s"), *Error);
@@ -201,8 +302,6 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 			{
 				for (const FHLSLShaderParser::FPragmaDeclarations& Pragma : PragmaDeclarations)
 				{
-					// Remove whitespaces first
-					Shader.Name.ReplaceInline(TEXT(" "), TEXT(""));
 					if (Shader.Name.Equals(Pragma.Name))
 					{
 						Shader.ShaderStage = Pragma.Type;
@@ -213,15 +312,13 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 
 				if (Shader.ShaderStage.IsEmpty())
 				{
-					FHLSLShaderMessages::ShowError(TEXT("Illegal function not corresponding to a declared shader stage: %s"), *Shader.Name);
+					FHLSLShaderMessages::ShowError(TEXT("Illegal function not corresponding to a declared shader stage: %s"), *Shader.Name.ToString());
 					return;
 				}
 			}
 
 			for (FHLSLStruct& Struct : Structs)
 			{
-				Struct.Name.ReplaceInline(TEXT(" "), TEXT(""));
-				Struct.Body.ReplaceInline(TEXT("\""), TEXT(""));
 				for (const FHLSLShaderParser::FPragmaDeclarations& Pragma : PragmaDeclarations)
 				{
 					if (Struct.Name.Equals(Pragma.Name))
@@ -232,7 +329,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 
 				if (Struct.ShaderStage.IsEmpty())
 				{
-					FHLSLShaderMessages::ShowError(TEXT("Illegal struct not corresponding to a declared shader stage: %s { \n %s \n };"), *Struct.Name, *Struct.Body);
+					FHLSLShaderMessages::ShowError(TEXT("Illegal struct not corresponding to a declared shader stage: %s { \n %s \n };"), *Struct.Name.ToString(), *Struct.Body.ToString());
 					return;
 				}
 			}
@@ -262,7 +359,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		{
 			if ((Shader.ShaderStage == FHLSLMaterialShader::PIXEL_SHADER && Shader.OutputStruct_Raw.ShaderStage.IsEmpty()) || Shader.InputStruct_Raw.ShaderStage.IsEmpty())
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Could not find associated input/output struct for: %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Could not find associated input/output struct for: %s"), *Shader.Name.ToString());
 				return;
 			}
 		}
@@ -276,15 +373,15 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		// Pixel Shaders
 		// void FuncName(FMaterialPixel/VertexParameters Parameters, InputStruct struct, out OutputStruct output); OR void FuncName(InputStruct struct, out OutputStruct output);
 		
-		if (FHLSLMaterialShader::PIXEL_SHADER != Shader.ShaderStage && Shader.ReturnType != "float3")
+		if (FHLSLMaterialShader::PIXEL_SHADER != Shader.ShaderStage && Shader.ReturnType != TEXT("float3"))
 		{
 			// We disallow output structs for vertex/normals and instead use the direct custom node output for them. The reason being is the custom outputs of the node don't seem to work when plugged into WPO/Normal attributes
-			FHLSLShaderMessages::ShowError(TEXT("%s Shader must return float3: %s %s"), *Shader.ShaderStage, *Shader.Name);
+			FHLSLShaderMessages::ShowError(TEXT("%s Shader must return float3: %s %s"), *Shader.ShaderStage, *Shader.Name.ToString());
 			return;
 		}
-		if (FHLSLMaterialShader::PIXEL_SHADER == Shader.ShaderStage && Shader.ReturnType != "void")
+		if (FHLSLMaterialShader::PIXEL_SHADER == Shader.ShaderStage && Shader.ReturnType != TEXT("void"))
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Pixel Shader must return void: %s"), *Shader.Name);
+			FHLSLShaderMessages::ShowError(TEXT("Pixel Shader must return void: %s"), *Shader.Name.ToString());
 			return;
 		}
 
@@ -294,7 +391,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 
 		if (Shader.Arguments.Num() < MinNumParameters || Shader.Arguments.Num() > MaxNumParameters)
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Error: Invalid shader function arguments: %s"), *Shader.Name);
+			FHLSLShaderMessages::ShowError(TEXT("Error: Invalid shader function arguments: %s"), *Shader.Name.ToString());
 			return;
 		}
 
@@ -302,10 +399,10 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		int32 ArgOffset = 0;
 		if (Shader.Arguments.Num() == MaxNumParameters)
 		{
-			const FString FirstArg = Shader.Arguments[0];
+			const FString FirstArg = Shader.Arguments[0].ToString();
 			if (!(FirstArg.Equals("FMaterialPixelParameters Parameters") || FirstArg.Equals("FMaterialVertexParameters Parameters")))
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse function parameters for shader [%s]"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse function parameters for shader [%s]"), *Shader.Name.ToString());
 				return;
 			}
 
@@ -314,78 +411,80 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 
 		if (Shader.ShaderStage == FHLSLMaterialShader::PIXEL_SHADER)
 		{
-			TArray<FString> ArgOneExplode, ArgTwoExplode;
-			TArray<FString> InputStructArgs, OutputStructArgs;
+			THLSLTempArray<FStringView> ArgOneExplode, ArgTwoExplode;
+			THLSLTempArray<FStringView> InputStructArgs, OutputStructArgs;
 
-			Shader.Arguments[0 + ArgOffset].ParseIntoArrayWS(ArgOneExplode);
-			Shader.Arguments[1 + ArgOffset].ParseIntoArrayWS(ArgTwoExplode);
+			SplitWhitespace(Shader.Arguments[0 + ArgOffset].GetView(), ArgOneExplode);
+			SplitWhitespace(Shader.Arguments[1 + ArgOffset].GetView(), ArgTwoExplode);
 
 			if(ArgOneExplode.IsEmpty() || ArgTwoExplode.IsEmpty())
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name.ToString());
 				return;
 			}
 
 			// Retrieve which of the arguments is the input/output structs
-			if (ArgOneExplode[0].Equals("out") && !ArgTwoExplode[0].Equals("out"))
+			if (ArgOneExplode[0].Equals(TEXT("out")) && !ArgTwoExplode[0].Equals(TEXT("out")))
 			{
 				InputStructArgs = ArgTwoExplode;
 				OutputStructArgs = ArgOneExplode;
 			}
-			else if (ArgTwoExplode[0].Equals("out") && !ArgOneExplode[0].Equals("out"))
+			else if (ArgTwoExplode[0].Equals(TEXT("out")) && !ArgOneExplode[0].Equals(TEXT("out")))
 			{
 				InputStructArgs = ArgOneExplode;
 				OutputStructArgs = ArgTwoExplode;
 			}
 			else
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name.ToString());
 				return;
 			}
 
 			// Verify that the input/output args are using the correct struct types
-			if (!InputStructArgs[0].Equals(Shader.InputStruct_Raw.Name) || !OutputStructArgs[1].Equals(Shader.OutputStruct_Raw.Name))
+			if (!Shader.InputStruct_Raw.Name.Equals(InputStructArgs[0]) || !Shader.OutputStruct_Raw.Name.Equals(OutputStructArgs[1]))
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name.ToString());
 				return;
 			}
 
 			// Remove struct explicit refs from function body
 			// 'Input.Param' -> 'Param'
 			// 'Output.Param' -> 'Param'
-			const FString FuncBodyInputStruct = InputStructArgs[1] + ".";
-			const FString FuncBodyOutputStruct = OutputStructArgs[2] + ".";
-			Shader.Body.ReplaceInline(ToCStr(FuncBodyInputStruct), TEXT(""));
-			Shader.Body.ReplaceInline(ToCStr(FuncBodyOutputStruct), TEXT(""));
+			const FString FuncBodyInputStruct = FString(InputStructArgs[1]) + ".";
+			const FString FuncBodyOutputStruct = FString(OutputStructArgs[2]) + ".";
+			Shader.ProcessedBody = Shader.Body.ToString();
+			Shader.ProcessedBody.ReplaceInline(ToCStr(FuncBodyInputStruct), TEXT(""));
+			Shader.ProcessedBody.ReplaceInline(ToCStr(FuncBodyOutputStruct), TEXT(""));
 		}
 		else // Normals & Vertex shader need to explicitly return a value
 		{
-			TArray<FString> InputStructArgs;
+			THLSLTempArray<FStringView> InputStructArgs;
 
-			Shader.Arguments[0 + ArgOffset].ParseIntoArrayWS(InputStructArgs);
+			SplitWhitespace(Shader.Arguments[0 + ArgOffset].GetView(), InputStructArgs);
 
 			if(InputStructArgs.IsEmpty())
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name.ToString());
 				return;
 			}
-			else if (InputStructArgs[0].Equals("out"))
+			else if (InputStructArgs[0].Equals(TEXT("out")))
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for [Out keyword illegal] %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for [Out keyword illegal] %s"), *Shader.Name.ToString());
 				return;
 			}
 
 			// Verify that the input/output args are using the correct struct types
-			if (!InputStructArgs[0].Equals(Shader.InputStruct_Raw.Name))
+			if (!Shader.InputStruct_Raw.Name.Equals(InputStructArgs[0]))
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name);
+				FHLSLShaderMessages::ShowError(TEXT("Error: Failed to parse input arguments for %s"), *Shader.Name.ToString());
 				return;
 			}
 
 			// Remove struct explicit refs from function body
 			// 'Input.Param' -> 'Param'
-			const FString FuncBodyInputStruct = InputStructArgs[1] + ".";
-			Shader.Body.ReplaceInline(ToCStr(FuncBodyInputStruct), TEXT(""));
+			const FString FuncBodyInputStruct = FString(InputStructArgs[1]) + ".";
+			Shader.ProcessedBody = Shader.Body.ToString();
+			Shader.ProcessedBody.ReplaceInline(ToCStr(FuncBodyInputStruct), TEXT(""));
 		}
 		
 	}
@@ -399,23 +498,27 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		
 		if (!InputErrors.IsEmpty() || !OutputErrors.IsEmpty())
 		{
-			FHLSLShaderMessages::ShowError(TEXT("%s: (%s) (%s)"), *Shader.Name, *InputErrors, *OutputErrors);
+			FHLSLShaderMessages::ShowError(TEXT("%s: (%s) (%s)"), *Shader.Name.ToString(), *InputErrors, *OutputErrors);
 			return;
 		}
+		FHLSLShaderParser::WarnIgnoredConstraints(Library, Shader);
 		
-		BaseHash += Shader.InputStruct_Raw.Name;
-		BaseHash += Shader.InputStruct_Raw.Body;
-		BaseHash += Shader.OutputStruct_Raw.Name;
-		BaseHash += Shader.OutputStruct_Raw.Body;
+		BaseHashBuilder.Update(Shader.InputStruct_Raw.Name.GetView());
+		BaseHashBuilder.Update(Shader.InputStruct_Raw.Body.GetView());
+		BaseHashBuilder.Update(Shader.OutputStruct_Raw.Name.GetView());
+		BaseHashBuilder.Update(Shader.OutputStruct_Raw.Body.GetView());
 
 		auto& Result = Library.ShaderResults.Emplace_GetRef();
-		Result.Arguments = Shader.Arguments;
-		Result.Body = Shader.Body;
-		Result.Name = Shader.Name;
-		Result.ReturnType = Shader.ReturnType;
+		for (const FHLSLSpan& Argument : Shader.Arguments)
+		{
+			Result.Arguments.Add(Argument.ToString());
+		}
+		Result.Body = Shader.ProcessedBody;
+		Result.Name = Shader.Name.ToString();
+		Result.ReturnType = Shader.ReturnType.ToString();
 		Result.ShaderStage = Shader.ShaderStage;
 
-		for (auto Input : Shader.Inputs)
+		for (const auto& Input : Shader.Inputs)
 		{
 			auto& InputDbg = Result.Inputs.Emplace_GetRef();
 			InputDbg.Name = Input.Name;
@@ -427,7 +530,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 			InputDbg.ShaderStage = Input.ShaderStage;
 			InputDbg.InputType = Input.InputType;
 			
-			for (auto Meta : Input.Meta)
+			for (const auto& Meta : Input.Meta)
 			{
 				auto& MetaDb = InputDbg.Meta.Emplace_GetRef();
 				MetaDb.Parameters = Meta.Parameters;
@@ -435,7 +538,7 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 			}
 		}
 
-		for (auto Output : Shader.Outputs)
+		for (const auto& Output : Shader.Outputs)
 		{
 			auto& OutputDbg = Result.Outputs.Emplace_GetRef();
 			OutputDbg.Name = Output.Name;
@@ -447,7 +550,68 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		}
 	}
 
+	// Shaders that weren't edited keep their hash
+	const FHLSLHash BaseHash = BaseHashBuilder.Finalize();
+	const FString BaseHashString = BaseHash.ToString();
+	FHLSLIncrementalParser& IncrementalParser = FHLSLShaderParser::GetIncrementalParser(Library);
+	for (int32 ShaderIndex = 0; ShaderIndex < Shaders.Num(); ShaderIndex++)
+	{
+		FHLSLMaterialShader& Shader = Shaders[ShaderIndex];
+		Shader.HashedString = IncrementalParser.GetFunctionHash(ShaderIndex, BaseHashString, [&]
+		{
+			return Shader.GenerateHashedString(BaseHash);
+		});
+	}
+
+	FHLSLMaterialIRCache::Save(Library, IRCacheVersion, SourceHash, [&](FArchive& Ar) { Ar << Shaders; });
+
+	UpdateMaterial(Library, IncludeFilePaths, IncludesDigest, Settings, Shaders, SourceFingerprint, bHasInvalidIncludes);
+}
+
+void FHLSLShaderLibraryEditor::UpdateMaterial(
+	UHLSLShaderLibrary& Library,
+	const TArray<FString>& IncludeFilePaths,
+	const FString& IncludesDigest,
+	const TArray<FHLSLShaderParser::FSetting>& Settings,
+	TArray<FHLSLMaterialShader>& Shaders,
+	const FString& SourceFingerprint,
+	const bool bHasInvalidIncludes)
+{
+	{
+		// Even if the material is up to date: the shaders might have moved in the file
+		TMap<FString, int32> ShaderLines;
+		for (const FHLSLMaterialShader& Shader : Shaders)
+		{
+			ShaderLines.Add(Shader.Name.ToString(), Shader.StartLine);
+		}
+		FHLSLMaterialErrorHook::SetFunctionLines(Library.File.FilePath, MoveTemp(ShaderLines));
+	}
+
+	FHLSLHashBuilder FingerprintBuilder;
+	FingerprintBuilder.Update(&Library.bAccurateErrors, sizeof(bool));
+	for (const FHLSLMaterialShader& Shader : Shaders)
+	{
+		FingerprintBuilder.Update(Shader.HashedString);
+	}
+	const FString Fingerprint = FingerprintBuilder.Finalize().ToString();
+
+	const auto GetPackageStamp = [&]
+	{
+		return Library.Materials.IsNull() ? FString() : FHLSLMaterialPackageStamp::Get({ Library.Materials.GetLongPackageName() });
+	};
+
+	// Same source as last time and the material wasn't touched since it was found up to date: no need to load it
+	const FString PackageStamp = GetPackageStamp();
+	if (Shaders.Num() > 0 &&
+		Library.GeneratedFingerprint == Fingerprint &&
+		!PackageStamp.IsEmpty() &&
+		Library.GeneratedPackageStamp == PackageStamp)
+	{
+		Library.SourceFingerprint = bHasInvalidIncludes ? FString() : SourceFingerprint;
 
+		UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *Library.GetName());
+		return;
+	}
 	
 	// Create or retrieve the material asset and set up its base settings first
 	{
@@ -459,22 +623,37 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		}
 	}
 
-	// Compare hash to see if we need to regenerate or if the material is up to date
-	for (UMaterialExpressionComment* Comment : Library.Materials->FunctionEditorComments)
+	// Compare hashes to see if we need to regenerate or if the material is up to date: each shader writes its hash in a comment
+	int32 NumUpToDateShaders = 0;
+	for (const FHLSLMaterialShader& Shader : Shaders)
 	{
-		if (Comment && Comment->Text.Contains(BaseHash))
+		for (UMaterialExpressionComment* Comment : Library.Materials->FunctionEditorComments)
 		{
-			UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *Library.GetName());
-			return;
+			if (Comment && Comment->Text.Contains(Shader.HashedString))
+			{
+				NumUpToDateShaders++;
+				break;
+			}
 		}
 	}
+	if (Shaders.Num() > 0 && NumUpToDateShaders == Shaders.Num())
+	{
+		// Generated before the fingerprint existed, or the material was saved since
+		Library.GeneratedFingerprint = Fingerprint;
+		Library.GeneratedPackageStamp = GetPackageStamp();
+		Library.SourceFingerprint = bHasInvalidIncludes ? FString() : SourceFingerprint;
+		Library.MarkPackageDirty();
+
+		UE_LOG(LogHLSLMaterial, Log, TEXT("%s already up to date"), *Library.GetName());
+		return;
+	}
 
 	// Generate the shaders
 	//FMaterialUpdateContext UpdateContext;
 	//UpdateContext.AddMaterial(Library.Materials.Get());
 	
 	// We're gonna be resetting everything, but to keep track of state, cache existing GUIDs and opt to add them as is back in instead of creating new ones if possible
-	TMap<FName, FGuid> ParameterGuids;
+	THLSLTempMap<FName, FGuid> ParameterGuids;
 	for (UMaterialExpression* Expression : Library.Materials->FunctionExpressions)
 	{
 		if (UMaterialExpressionParameter* Parameter = Cast<UMaterialExpressionParameter>(Expression))
@@ -483,6 +662,8 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		}
 	}
 
+	bool bHasErrors = false;
+
 	// Setup transaction for material generation then start generating
 	{
 		const FScopedTransaction Transaction( NSLOCTEXT("HLSLShader", "MaterialShaderRegen", "HLSL SHader: Material Regeneration") );
@@ -526,17 +707,17 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 		}
 
 		// Before we start generating the shader, lets make sure to recompile changed ush files. This is so if we were modifying stuff in includes, it'll be reflected (otherwise it wont until we manually do it)
-		if (true) // Maybe it can be an option
+		// Only when an include actually changed, as this goes through every shader of the project
+		if (FHLSLMaterialIncludeCache::ConsumeChanges())
 		{
 			GEngine->Exec(GEditor->GetEditorWorldContext().World(), TEXT("RECOMPILESHADERS CHANGED"));
 		}
 
-		for (FHLSLMaterialShader Shader : Shaders)
+		for (int32 ShaderIndex = 0; ShaderIndex < Shaders.Num(); ShaderIndex++)
 		{
+			FHLSLMaterialShader& Shader = Shaders[ShaderIndex];
 			TArray<FString> IncludesToUse = ShaderStageIncludes.Equals(Shader.ShaderStage) ? IncludeFilePaths : TArray<FString>();
 
-			Shader.HashedString = Shader.GenerateHashedString(BaseHash);
-
 			// Add dummy output for loops to work
 			if (Shader.ShaderStage != FHLSLMaterialShader::PIXEL_SHADER)
 			{
@@ -550,12 +731,14 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 			const FString Error = FHLSLShaderGenerator::GenerateShader(
 				Library,
 				IncludesToUse,
+				IncludesToUse.Num() > 0 ? IncludesDigest : FString(),
 				Shader,
 				ParameterGuids);
 		
 			if (!Error.IsEmpty())
 			{
-				FHLSLShaderMessages::ShowError(TEXT("Shader %s: %s"), *Shader.Name, *Error);
+				FHLSLShaderMessages::ShowError(TEXT("Shader %s: %s"), *Shader.Name.ToString(), *Error);
+				bHasErrors = true;
 			}
 		}
 
@@ -576,6 +759,13 @@ void FHLSLShaderLibraryEditor::Generate(UHLSLShaderLibrary& Library)
 			if (ShaderEditor) ShaderEditor->NotifyExternalMaterialChange();
 		}
 	}
+
+	// Failed shaders must be generated again next time, even if the source didn't change
+	Library.GeneratedFingerprint = bHasErrors ? FString() : Fingerprint;
+	// Not saved yet: the next update checks the comments once the material is saved
+	Library.GeneratedPackageStamp.Reset();
+	Library.SourceFingerprint = bHasErrors || bHasInvalidIncludes ? FString() : SourceFingerprint;
+	Library.MarkPackageDirty();
 	
 	// message
 	FNotificationInfo Info(FText::Format(INVTEXT("{0} updated"), FText::FromString(Library.GetFilePath())));
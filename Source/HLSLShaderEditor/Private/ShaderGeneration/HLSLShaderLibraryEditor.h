@@ -7,6 +7,7 @@
 #include "MaterialShared.h"
 
 class UHLSLShaderLibrary;
+struct FHLSLMaterialShader;
 
 class FHLSLShaderLibraryEditor
 {
@@ -20,6 +21,17 @@ public:
 	static void Generate(UHLSLShaderLibrary& Library);
 
 private:
+	// Everything after parsing: compares the fingerprints, and regenerates the material if they differ
+	static void UpdateMaterial(
+		UHLSLShaderLibrary& Library,
+		const TArray<FString>& IncludeFilePaths,
+		// Digest of the included files, empty if there are none
+		const FString& IncludesDigest,
+		const TArray<FHLSLShaderParser::FSetting>& Settings,
+		TArray<FHLSLMaterialShader>& Shaders,
+		const FString& SourceFingerprint,
+		bool bHasInvalidIncludes);
+
 	static FString GenerateMaterialForShader(UHLSLShaderLibrary& Library, const TArray<FHLSLShaderParser::FSetting>& MaterialSettings);
 	static void GenerateMaterialInstanceForShader(UHLSLShaderLibrary& Library);
 
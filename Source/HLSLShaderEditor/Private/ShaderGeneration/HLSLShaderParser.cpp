@@ -3,311 +3,58 @@
 
 #include "HLSLShaderParser.h"
 
+#include "HLSLParser.h"
 #include "HLSLShader.h"
 #include "HLSLShaderLibrary.h"
 #include "HLSLShaderMessages.h"
+#include "HLSLMaterialUtilities.h"
 #include "ShaderCore.h"
-#include "Internationalization/Regex.h"
+#include "Materials/MaterialExpressionFunctionInput.h"
 #include "Misc/Paths.h"
 
 FString FHLSLShaderParser::Parse(const UHLSLShaderLibrary& Library, FString Text, TArray<FHLSLMaterialShader>& OutFunctions,
 	TArray<FHLSLStruct>& OutStructs)
 {
-	enum class EScope
-	{
-		Global,
-		Preprocessor,
-		GlobalComment,
-		FunctionReturn,
-		FunctionName,
-		FunctionArgs,
-		FunctionBodyStart,
-		FunctionBody,
-		StructStart,
-		StructName,
-		StructBodyStart,
-		StructBody,
-	};
-
-	EScope Scope = EScope::Global;
-	int32 Index = 0;
-	int32 ScopeDepth = 0; // Increment when encountering {, decrement when encoutnering }
-	int32 ArgParenthesisScopeDepth = 0; // Increment when encountering ( decrement when ) in FunctionArgs scope
-	int32 LineNumber = 0;
-
-	// Simplify line breaks handling
-	Text.ReplaceInline(TEXT("\r\n"), TEXT("\n"));
-
-	while (Index < Text.Len())
-	{
-		FString Token;
-		for (int32 TokenIndex = Index; TokenIndex < Text.Len() && !FChar::IsWhitespace(Text[TokenIndex]); TokenIndex++)
-		{
-			Token += Text[TokenIndex];
-		}
-		
-		const TCHAR Char = Text[Index++];
-		
-		if (FChar::IsLinebreak(Char))
-		{
-			LineNumber++;
-		}
-
-		// State machine
-		switch (Scope)
-		{
-		case EScope::Global:
-		{
-			ensure(ScopeDepth == 0);
-
-			// Skip over line breaks and white space
-			if (FChar::IsWhitespace(Char) || FChar::IsLinebreak(Char))
-			{
-				continue;
-			}
-
-			if (OutFunctions.Num() == 0 || !OutFunctions.Last().ReturnType.IsEmpty())
-			{
-				OutFunctions.Emplace();
-			}
-
-			// Decrement the index so when we go into the next states, we're not skipping thee first character
-			Index--;
-
-			if (Char == TEXT('#'))
-			{
-				Scope = EScope::Preprocessor;
-			}
-			else if (Char == TEXT('/'))
-			{
-				Scope = EScope::GlobalComment;
-			}
-			else if (Token == TEXT("struct"))
-			{
-				Scope = EScope::StructStart;
-				OutStructs.Emplace();
-			}
-			else
-			{
-				Scope = EScope::FunctionReturn;
-			}
-		}
-		break;
-		case EScope::Preprocessor:
-		case EScope::GlobalComment:
-		{
-			// Don't care for global comments & we've already preprocessed # directives, so skip till the next line
-			if (!FChar::IsLinebreak(Char)) continue;
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::FunctionReturn:
-		{
-			if (!FChar::IsWhitespace(Char))
-			{
-				OutFunctions.Last().ReturnType += Char;
-				continue;
-			}
+	FHLSLParseOptions Options;
+	Options.bAccurateErrors = Library.bAccurateErrors;
 
-			Scope = EScope::FunctionName;
-		}
-		break;
-		case EScope::FunctionName:
-		{
-			// Stop when we encounter the function args 
-			if (Char != TEXT('('))
-			{
-				if (!FChar::IsWhitespace(Char))
-				{
-					OutFunctions.Last().Name += Char;
-				}
-				continue;
-			}
-
-			Scope = EScope::FunctionArgs;
-
-			ensure(ArgParenthesisScopeDepth == 0);
-			ArgParenthesisScopeDepth++;
-		}
-		break;
-		case EScope::FunctionArgs:
-		{
-			// We don't worry about checking parenthesis scope depth here as we should never encoutner an open scope, function arguments should always be of the form:
-			// (FMaterialPixel/VertexParameters Parameters, VS/PS/NormInput input, out VS/PS/NormOutput output)
-
-			// What we care about here is the names of the input/out structs, because we're gonna be stripping them from the function body
-
-			if (Char == TEXT('(')) ArgParenthesisScopeDepth++;
-			if (Char == TEXT(')'))
-			{
-				ArgParenthesisScopeDepth--;
-				ensure(ArgParenthesisScopeDepth >= 0);
-			}
-
-			if (ArgParenthesisScopeDepth > 0)
-			{
-				if (Char == TEXT(',') && ArgParenthesisScopeDepth == 1)
-				{
-					OutFunctions.Last().Arguments.Emplace();
-				}
-				else
-				{
-					if (OutFunctions.Last().Arguments.Num() == 0) OutFunctions.Last().Arguments.Emplace();
-
-					OutFunctions.Last().Arguments.Last() += Char;
-				}
-				continue;
-			}
-			
-			Scope = EScope::FunctionBodyStart;
-		}
-		break;
-		case EScope::FunctionBodyStart:
-		{
-			ensure(ScopeDepth == 0);
-
-			if (Char != TEXT('{')) continue;
-
-			/* Fix above for comments right after function args
-			if (FChar::IsWhitespace(Char)) continue;
-
-			if (Char != TEXT('{'))
-			{
-				return FString::Printf(TEXT("Invalid function body for %s: missing {"), *OutFunctions.Last().Name);
-			}
-			*/
-			
-			if (Library.bAccurateErrors)
-			{
-				OutFunctions.Last().StartLine = LineNumber;
-			}
-
-			Scope = EScope::FunctionBody;
-			ScopeDepth++;
-		}
-		break;
-		case EScope::FunctionBody:
-		{
-			ensure(ScopeDepth > 0);
-
-			if (Char == TEXT('{'))
-			{
-				ScopeDepth++;
-			}
-			if (Char == TEXT('}'))
-			{
-				ScopeDepth--;
-			}
-
-			if (ScopeDepth > 0)
-			{
-				OutFunctions.Last().Body += Char;
-				continue;
-			}
-			if (ScopeDepth < 0)
-			{
-				return FString::Printf(TEXT("Invalid function body for %s: too many }"), *OutFunctions.Last().Name);
-			}
-
-			ensure(ScopeDepth == 0);
-			Scope = EScope::Global;
-		}
-		break;
-		case EScope::StructStart:
-		{
-			if (!FChar::IsWhitespace(Char)) continue;
+	TArray<FHLSLParsedFunction> Functions;
+	TArray<FHLSLParsedStruct> Structs;
+	const FString Error = GetIncrementalParser(Library).Parse(Options, MoveTemp(Text), Functions, Structs);
+	if (!Error.IsEmpty())
+	{
+		return Error;
+	}
 
-			Scope = EScope::StructName;
-		}
-		break;
-		case EScope::StructName:
-		{
-			if (Char != TEXT('{') && Char != TEXT('/'))
-			{
-				if (!FChar::IsWhitespace(Char) || !FChar::IsLinebreak(Char))
-				{
-					OutStructs.Last().Name += Char;
-				}
-				continue;
-			}
+	for (FHLSLParsedFunction& Function : Functions)
+	{
+		static_cast<FHLSLParsedFunction&>(OutFunctions.Emplace_GetRef()) = MoveTemp(Function);
+	}
+	for (FHLSLParsedStruct& Struct : Structs)
+	{
+		static_cast<FHLSLParsedStruct&>(OutStructs.Emplace_GetRef()) = MoveTemp(Struct);
+	}
 
-			if (Char == TEXT('{'))
-			{
-				Scope = EScope::StructBody;
-				ScopeDepth++;
-			}
-			else
-			{
-				Scope = EScope::StructBodyStart;
-			}
-		}
-		break;
-		case EScope::StructBodyStart:
-		{
-			ensure(ScopeDepth == 0);
-			
-			if (Char != TEXT('{')) continue;
+	return {};
+}
 
-			/* Fix above for comment after struct name, we know enter the structbody state earlier than before.
-			if (FChar::IsWhitespace(Char) || FChar::IsLinebreak(Char)) continue;
+FHLSLIncrementalParser& FHLSLShaderParser::GetIncrementalParser(const UHLSLShaderLibrary& Library)
+{
+	static TMap<TWeakObjectPtr<const UHLSLShaderLibrary>, FHLSLIncrementalParser> Parsers;
 
-			if (Char != TEXT('{'))
-			{
-				return FString::Printf(TEXT("Invalid struct body for %s: missing {"), *OutStructs.Last().Name);
-			}
-			*/
-			
-			Scope = EScope::StructBody;
-			ScopeDepth++;
-		}
-		break;
-		case EScope::StructBody:
+	// Forget deleted libraries
+	for (auto It = Parsers.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
 		{
-			if (Char == TEXT(';') && ScopeDepth == 0)
-			{
-				Scope = EScope::Global;
-				continue;
-			}
-			
-			ensure(ScopeDepth > 0);
-
-			if (Char == TEXT('{')) ScopeDepth++;
-			if (Char == TEXT('}')) ScopeDepth--;
-			
-			if (ScopeDepth > 0)
-			{
-				OutStructs.Last().Body += Char;
-				continue;
-			}
-			if (ScopeDepth < 0)
-			{
-				return FString::Printf(TEXT("Invalid struct body for %s: too many }"), *OutFunctions.Last().Name);
-			}
-
-			// We exit when scope depth == 0 & we encounter a ;
-			ensure(ScopeDepth == 0);
-		}
-		break;
-		default: ensure(false);
+			It.RemoveCurrent();
 		}
 	}
 
-	// We're always adding 1 additional function to the array, so lets remove that
-	if (OutFunctions.Last().ReturnType.IsEmpty())
-		OutFunctions.RemoveAtSwap(OutFunctions.Num()-1);
-
-	if (Scope != EScope::Global && Scope != EScope::GlobalComment)
-	{
-		return TEXT("Parsing Error");
-	}
-
-	ensure(ScopeDepth == 0);
-	ensure(ArgParenthesisScopeDepth == 0);
-
-	return {};
+	return Parsers.FindOrAdd(&Library);
 }
 
-TArray<FHLSLShaderParser::FInclude> FHLSLShaderParser::GetIncludes(const FString& FilePath, const FString& Text)
+FHLSLShaderParser::FDirectives FHLSLShaderParser::GetDirectives(const FString& FilePath, const FString& Text)
 {
 	FString VirtualFolder;
 	if (UHLSLShaderLibrary::TryConvertFilenameToShaderPath(FilePath, VirtualFolder))
@@ -315,13 +62,14 @@ TArray<FHLSLShaderParser::FInclude> FHLSLShaderParser::GetIncludes(const FString
 		VirtualFolder = FPaths::GetPath(VirtualFolder);
 	}
 
-	TArray<FInclude> OutIncludes;
+	const FHLSLParsedDirectives ParsedDirectives = FHLSLParser::GetDirectives(Text);
+
+	FDirectives OutDirectives;
 
-	FRegexPattern RegexPattern(R"_((\A|\v)\s*#include "([^"]+)")_");
-	FRegexMatcher RegexMatcher(RegexPattern, Text);
-	while (RegexMatcher.FindNext())
+	for (const FHLSLParsedInclude& Include : ParsedDirectives.Includes)
 	{
-		FString VirtualPath = RegexMatcher.GetCaptureGroup(2);
+		FString VirtualPath = Include.Path;
+
 		// Nice includes to have for intellisense but dont actually include them as it wont work
 		if (VirtualPath.Contains("MaterialTemplate.ush", ESearchCase::CaseSensitive)) continue;
 		
@@ -334,103 +82,162 @@ TArray<FHLSLShaderParser::FInclude> FHLSLShaderParser::GetIncludes(const FString
 		FString DiskPath = GetShaderSourceFilePath(VirtualPath);
 		if (DiskPath.IsEmpty())
 		{
-			FHLSLShaderMessages::ShowError(TEXT("Failed to map include %s"), *VirtualPath);
+			FHLSLShaderMessages::ShowError(TEXT("Failed to map include %s (line %d)"), *VirtualPath, Include.Line);
 		}
 		else
 		{
 			DiskPath = FPaths::ConvertRelativePathToFull(DiskPath);
 		}
 
-		OutIncludes.Add({ VirtualPath, DiskPath });
+		OutDirectives.Includes.Add({ VirtualPath, DiskPath, Include.Line });
 	}
 
-	return OutIncludes;
-}
-
-TArray<FHLSLShaderParser::FSetting> FHLSLShaderParser::GetSettings(const FString& Text)
-{
-	TArray<FHLSLShaderParser::FSetting> OutDefines;
+	for (const FHLSLParsedDefine& Define : ParsedDirectives.Defines)
+	{
+		OutDirectives.Settings.Add({ Define.Name, Define.Value, Define.Line });
+	}
 
-	FRegexPattern RegexPattern(R"_((\A|\v)\s*#define (\w*) (.*))_");
-	FRegexMatcher RegexMatcher(RegexPattern, Text);
-	while (RegexMatcher.FindNext())
+	for (const FHLSLParsedPragma& Pragma : ParsedDirectives.Pragmas)
 	{
-		OutDefines.Add({ RegexMatcher.GetCaptureGroup(2), RegexMatcher.GetCaptureGroup(3) });
+		OutDirectives.PragmaDeclarations.Add({ Pragma.Type, Pragma.Name, Pragma.Line });
 	}
 
-	return OutDefines;
+	return OutDirectives;
 }
 
-TArray<FHLSLShaderParser::FPragmaDeclarations> FHLSLShaderParser::GetPragmaDeclarations(const FString& Text)
+TArray<FHLSLShaderParser::FInclude> FHLSLShaderParser::GetIncludes(const FString& FilePath, const FString& Text)
 {
-	TArray<FHLSLShaderParser::FPragmaDeclarations> OutDefines;
-
-	FRegexPattern RegexPattern(R"_((\A|\v)\s*#pragma (\w*) (\w*))_");
-	FRegexMatcher RegexMatcher(RegexPattern, Text);
-	while (RegexMatcher.FindNext())
-	{
-		OutDefines.Add({ RegexMatcher.GetCaptureGroup(2), RegexMatcher.GetCaptureGroup(3) });
-	}
-
-	return OutDefines;
+	return GetDirectives(FilePath, Text).Includes;
 }
 
 FString FHLSLShaderParser::ParseInputStructs(const UHLSLShaderLibrary& Library, const FHLSLStruct& Struct, TArray<FHLSLShaderInput>& Inputs)
 {
-	FRegexPattern RegexPattern(""
-		R"_(\s*)_"                      // Start
-		R"_((?:\[(.*)\])?)_"             // [Metadata]
-		R"_(\s*)_"                       // Spaces
-		R"_((?:(\/\/\s*))?)_"			// Possible comment that we wanna check if its empty (unless theres a newline following it)
-		R"_((?:(const\s+)?))_"			// Either const or out
-		R"_((\w*))_"                     // Type
-		R"_(\s+)_"                       // Spaces
-		R"_((\w*))_"                     // Name
-		R"_((?:\s*=\s*(.+))?)_"          // Optional default value
-		R"_(\s*;)_");                    // End
-	
-	FRegexMatcher RegexMatcher(RegexPattern, Struct.Body);
-
-	while (RegexMatcher.FindNext())
+	TArray<FHLSLParsedDeclarator> Members;
 	{
-		if (!RegexMatcher.GetCaptureGroup(2).IsEmpty() && !RegexMatcher.GetCaptureGroup(2).Contains("\n")) continue;
+		const FString Error = FHLSLParser::ParseStructMembers(Struct.Body, Members);
+		if (!Error.IsEmpty()) return Error;
+	}
 
+	for (FHLSLParsedDeclarator& Member : Members)
+	{
 		// If we're dealing with a SamplerState, then skip it since it gets autogenerated for texture objects
-		if (RegexMatcher.GetCaptureGroup(4) == "SamplerState") continue;
+		if (Member.Type == "SamplerState") continue;
+
+		if (!Member.ArraySize.IsEmpty())
+		{
+			return Member.Name + ": arrays are not supported as inputs";
+		}
 		
 		FHLSLShaderInput& Input = Inputs.Emplace_GetRef();
-		Input.MetaStringRaw = RegexMatcher.GetCaptureGroup(1);
-		Input.bIsConst = !RegexMatcher.GetCaptureGroup(3).IsEmpty();
-		Input.Type = RegexMatcher.GetCaptureGroup(4);
-		Input.Name = RegexMatcher.GetCaptureGroup(5);
-		Input.DefaultValue = RegexMatcher.GetCaptureGroup(6);
+		// Quotes are allowed in the metadata but not needed
+		Input.MetaStringRaw = Member.Metadata.Replace(TEXT("\""), TEXT(""));
+		Input.bIsConst = Member.bIsConst;
+		Input.Type = MoveTemp(Member.Type);
+		Input.Name = MoveTemp(Member.Name);
+		Input.DefaultValue = MoveTemp(Member.DefaultValue);
 
 		FString Error = FHLSLShaderInput::ParseMetaAndDefault(Library, Input);
 		if (!Error.IsEmpty()) return Error;
 	}
 
+	// Permutation constraints can only be checked once all the inputs are known
+	TMap<FString, TArray<FString>> OneOfGroups;
+	for (const FHLSLShaderInput& Input : Inputs)
+	{
+		for (const FHLSLShaderInputMeta& Meta : Input.Meta)
+		{
+			const FString Tag = Meta.Tag.ToLower();
+			if (Tag == "oneof")
+			{
+				OneOfGroups.FindOrAdd(Meta.Parameters[0].TrimStartAndEnd()).Add(Input.Name);
+				continue;
+			}
+			if (Tag != "requires" && Tag != "excludes")
+			{
+				continue;
+			}
+
+			const FString Target = Meta.Parameters[0].TrimStartAndEnd();
+			if (Target == Input.Name)
+			{
+				return Input.Name + ": " + Meta.Tag + " can't reference the input it's on";
+			}
+
+			const FHLSLShaderInput* TargetInput = Inputs.FindByPredicate([&](const FHLSLShaderInput& Other) { return Other.Name == Target; });
+			if (!TargetInput || TargetInput->InputType != FunctionInput_StaticBool)
+			{
+				return Input.Name + ": " + Meta.Tag + "(" + Target + ") doesn't reference a bool input of " + Struct.Name.ToString();
+			}
+		}
+	}
+	for (const auto& It : OneOfGroups)
+	{
+		if (It.Value.Num() < 2)
+		{
+			return It.Value[0] + ": OneOf(" + It.Key + ") is the only bool in its group, it wouldn't constrain anything";
+		}
+	}
+
 	return "";
 }
 
+void FHLSLShaderParser::WarnIgnoredConstraints(const UHLSLShaderLibrary& Library, const FHLSLMaterialShader& Shader)
+{
+	// Same test as the generator to skip the bools the body never reads
+	const FString Code = FHLSLParser::CanonicalizeCode(Shader.ProcessedBody, false);
+
+	for (const FHLSLShaderInput& Input : Shader.Inputs)
+	{
+		for (const FHLSLShaderInputMeta& Meta : Input.Meta)
+		{
+			const FString Tag = Meta.Tag.ToLower();
+			if (Tag != "requires" && Tag != "excludes" && Tag != "oneof")
+			{
+				continue;
+			}
+
+			if (Library.bFoldStaticBools)
+			{
+				UE_LOG(LogHLSLMaterial, Warning, TEXT("%s: %s on %s is ignored, bFoldStaticBools doesn't generate permutations"),
+					*Shader.Name.ToString(), *Meta.Tag, *Input.Name);
+			}
+			else if (!FHLSLParser::ContainsIdentifier(Code, Input.Name))
+			{
+				UE_LOG(LogHLSLMaterial, Warning, TEXT("%s: %s on %s is ignored, the shader never reads %s"),
+					*Shader.Name.ToString(), *Meta.Tag, *Input.Name, *Input.Name);
+			}
+			else if (Tag != "oneof")
+			{
+				const FString Target = Meta.Parameters[0].TrimStartAndEnd();
+				if (!FHLSLParser::ContainsIdentifier(Code, Target))
+				{
+					UE_LOG(LogHLSLMaterial, Warning, TEXT("%s: %s(%s) on %s is ignored, the shader never reads %s"),
+						*Shader.Name.ToString(), *Meta.Tag, *Target, *Input.Name, *Target);
+				}
+			}
+		}
+	}
+}
+
 FString FHLSLShaderParser::ParseOutputStructs(const UHLSLShaderLibrary& Library, const FHLSLStruct& Struct, TArray<FHLSLShaderOutput>& Outputs)
 {
-	FRegexPattern RegexPattern(""
-		R"_(\s*)_"                      // Start
-		R"_((\w+))_"					// Type
-		R"_(\s+)_"						// Spaces
-		R"_((\w+))_"                       // Name
-		R"_(\s*:\s*)_"						// Semantic divider
-		R"_((\w+))_"			// Semantic
-		R"_(\s*;)_");                     // End
-	
-	FRegexMatcher RegexMatcher(RegexPattern, Struct.Body);
+	TArray<FHLSLParsedDeclarator> Members;
+	{
+		const FString Error = FHLSLParser::ParseStructMembers(Struct.Body, Members);
+		if (!Error.IsEmpty()) return Error;
+	}
 
-	while (RegexMatcher.FindNext())
+	for (FHLSLParsedDeclarator& Member : Members)
 	{
+		if (Member.Semantic.IsEmpty())
+		{
+			return Member.Name + ": outputs need a semantic, eg float3 Color : BaseColor;";
+		}
+
 		FHLSLShaderOutput& Output = Outputs.Emplace_GetRef();
-		Output.Type = RegexMatcher.GetCaptureGroup(1);
-		Output.Name = RegexMatcher.GetCaptureGroup(2);
-		Output.Semantic = RegexMatcher.GetCaptureGroup(3);
+		Output.Type = MoveTemp(Member.Type);
+		Output.Name = MoveTemp(Member.Name);
+		Output.Semantic = MoveTemp(Member.Semantic);
 
 		FString Error = FHLSLShaderOutput::ParseTypeAndSemantic(Output);
 		if (!Error.IsEmpty()) return Error;
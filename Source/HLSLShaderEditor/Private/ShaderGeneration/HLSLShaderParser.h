@@ -8,6 +8,7 @@ struct FHLSLMaterialShader;
 struct FHLSLStruct;
 struct FHLSLShaderInput;
 struct FHLSLShaderOutput;
+class FHLSLIncrementalParser;
 class UHLSLShaderLibrary;
 
 class FHLSLShaderParser
@@ -20,28 +21,43 @@ public:
 		TArray<FHLSLMaterialShader>& OutFunctions,
 		TArray<FHLSLStruct>& OutStructs);
 
+	// Keeps the last parse of each library, so that only the declarations edited since are reparsed
+	static FHLSLIncrementalParser& GetIncrementalParser(const UHLSLShaderLibrary& Library);
+
 	struct FInclude
 	{
 		FString VirtualPath;
 		FString DiskPath;
+		int32 Line = 0;
 	};
 	
 	struct FSetting
 	{
 		FString Setting;
 		FString Value;
+		int32 Line = 0;
 	};
 
 	struct FPragmaDeclarations
 	{
 		FString Type;
 		FString Name;
+		int32 Line = 0;
 	};
-	
+
+	struct FDirectives
+	{
+		TArray<FInclude> Includes;
+		TArray<FSetting> Settings;
+		TArray<FPragmaDeclarations> PragmaDeclarations;
+	};
+
+	// Includes, settings & pragma declarations, all collected in a single pass
+	static FDirectives GetDirectives(const FString& FilePath, const FString& Text);
 	static TArray<FInclude> GetIncludes(const FString& FilePath, const FString& Text);
-	static TArray<FSetting> GetSettings(const FString& Text);
-	static TArray<FPragmaDeclarations> GetPragmaDeclarations(const FString& Text);
 
 	static FString ParseInputStructs(const UHLSLShaderLibrary& Library, const FHLSLStruct& Struct, TArray<FHLSLShaderInput>& Inputs);
+	// Logs the Requires/Excludes/OneOf tags that won't prune any permutation: with bFoldStaticBools, or naming a bool the body never reads
+	static void WarnIgnoredConstraints(const UHLSLShaderLibrary& Library, const FHLSLMaterialShader& Shader);
 	static FString ParseOutputStructs(const UHLSLShaderLibrary& Library, const FHLSLStruct& Struct, TArray<FHLSLShaderOutput>& Outputs);
 };
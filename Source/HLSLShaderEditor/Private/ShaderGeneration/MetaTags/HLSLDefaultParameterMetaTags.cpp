@@ -151,3 +151,57 @@ void FHLSLMetaTag_SamplerType::SetupExpressionMetaTag(UMaterialExpression* Expre
 	}
 	else checkf(false, TEXT("Invalid expression passed to sampler type meta tag!"));
 }
+
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+
+FString FHLSLMetaTag_Requires::Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+	const FHLSLShaderInputMeta& MetaData) const
+{
+	if (InputType != FunctionInput_StaticBool)
+	{
+		return "Requires meta tag is only valid on bool inputs";
+	}
+	if (MetaData.Parameters[0].TrimStartAndEnd().IsEmpty())
+	{
+		return "Requires meta tag expects the name of another bool input";
+	}
+	return "";
+}
+
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+
+FString FHLSLMetaTag_Excludes::Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+	const FHLSLShaderInputMeta& MetaData) const
+{
+	if (InputType != FunctionInput_StaticBool)
+	{
+		return "Excludes meta tag is only valid on bool inputs";
+	}
+	if (MetaData.Parameters[0].TrimStartAndEnd().IsEmpty())
+	{
+		return "Excludes meta tag expects the name of another bool input";
+	}
+	return "";
+}
+
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+
+FString FHLSLMetaTag_OneOf::Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+	const FHLSLShaderInputMeta& MetaData) const
+{
+	if (InputType != FunctionInput_StaticBool)
+	{
+		return "OneOf meta tag is only valid on bool inputs";
+	}
+	if (MetaData.Parameters[0].TrimStartAndEnd().IsEmpty())
+	{
+		return "OneOf meta tag expects a group name, at most one bool of the group can be true";
+	}
+	return "";
+}
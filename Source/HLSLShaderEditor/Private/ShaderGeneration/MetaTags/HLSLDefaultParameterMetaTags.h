@@ -45,4 +45,35 @@ struct FHLSLMetaTag_SamplerType : FHLSLMetaTagHandler
 	virtual FString Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
 		const FHLSLShaderInputMeta& MetaData) const override;
 	virtual void SetupExpressionMetaTag(UMaterialExpression* Expression, const FHLSLShaderInputMeta& MetaTag) override;
+};
+
+struct FHLSLMetaTag_Requires : FHLSLMetaTagHandler
+{
+	virtual TArray<int> GetNumParameters() const override { return {1}; }
+	
+	virtual FString Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+		const FHLSLShaderInputMeta& MetaData) const override;
+	// Only constrains the permutations, nothing to set on the parameter
+	virtual void SetupExpressionMetaTag(UMaterialExpression* Expression, const FHLSLShaderInputMeta& MetaTag) override {}
+};
+
+struct FHLSLMetaTag_Excludes : FHLSLMetaTagHandler
+{
+	virtual TArray<int> GetNumParameters() const override { return {1}; }
+	
+	virtual FString Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+		const FHLSLShaderInputMeta& MetaData) const override;
+	// Only constrains the permutations, nothing to set on the parameter
+	virtual void SetupExpressionMetaTag(UMaterialExpression* Expression, const FHLSLShaderInputMeta& MetaTag) override {}
+};
+
+// At most one bool of the group is true: all of them false is a valid permutation too
+struct FHLSLMetaTag_OneOf : FHLSLMetaTagHandler
+{
+	virtual TArray<int> GetNumParameters() const override { return {1}; }
+	
+	virtual FString Validate(const UHLSLShaderLibrary& Library, EFunctionInputType InputType,
+		const FHLSLShaderInputMeta& MetaData) const override;
+	// Only constrains the permutations, nothing to set on the parameter
+	virtual void SetupExpressionMetaTag(UMaterialExpression* Expression, const FHLSLShaderInputMeta& MetaTag) override {}
 };
\ No newline at end of file
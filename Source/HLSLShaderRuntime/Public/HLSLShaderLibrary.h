@@ -154,20 +154,47 @@ class HLSLSHADERRUNTIME_API UHLSLShaderLibrary : public UObject
 	//
 	// ie, errors will look like MyFile.hlsl:9 instead of /Generated/Material.usf:2330
 	// 
-	// The downside is that whenever you add or remove a line to your file, all the functions below it will have to be recompiled
-	// If compilation is taking forever for you, consider turning this off
+	// Lines are relative to each function and mapped back to the file when displaying the error,
+	// so adding or removing a line to your file doesn't recompile the functions below it
 	UPROPERTY(EditAnywhere, Category = "Config")
 	bool bAccurateErrors = true;
 
 	UPROPERTY(EditAnywhere, Category = "Config")
 	bool bAutomaticallyApply = true;
 
+	// If true, the outputs of each permutation are packed in a single Material Attributes, and the static bools switch that instead of each output
+	// A shader with 8 outputs & 4 static bools then needs 15 switches instead of 120, making the material faster to translate
+	UPROPERTY(EditAnywhere, Category = "Config")
+	bool bSwitchMaterialAttributes = false;
+
+	// If true, a single custom node is generated for each shader, and each static bool is passed to it as a constant picked by a static switch
+	// The shader compiler folds the branches on these constants, so each permutation still only contains the code it uses
+	// If false, the code is duplicated for every combination of the static bools: 10 static bools are 1024 custom nodes
+	UPROPERTY(EditAnywhere, Category = "Config")
+	bool bFoldStaticBools = false;
+
 	UPROPERTY(EditAnywhere, Category = "Config")
 	TArray<UMaterialParameterCollection*> ParameterCollections;
 	
 	UPROPERTY(EditAnywhere, Category = "Generated")
 	TSoftObjectPtr<UMaterial> Materials;
 
+	// Fingerprint of the source Materials was last generated from
+	// Searchable so that stale libraries can be found from the asset registry, without loading the material
+	UPROPERTY(VisibleAnywhere, Category = "Generated", AssetRegistrySearchable)
+	FString GeneratedFingerprint;
+
+	// Saved state of Materials when it was last found matching GeneratedFingerprint
+	// If the material was reverted or edited since, it's loaded to check its hash comments
+	UPROPERTY()
+	FString GeneratedPackageStamp;
+
+	// Fingerprint of the raw file & includes the last time Materials was found up to date
+	// Editors send several change events per save: all but the first one can skip parsing entirely,
+	// as long as Materials still matches GeneratedPackageStamp
+	UPROPERTY(Transient)
+	FString SourceFingerprint;
+
 	UPROPERTY(VisibleAnywhere, Category="Debug")
 	TArray<FHLSLShaderResults> ShaderResults;
 	